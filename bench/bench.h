@@ -0,0 +1,27 @@
+#ifndef _DR25_BENCH_H_
+#define _DR25_BENCH_H_
+
+#include <cstdio>
+#include <chrono>
+
+// The time per element in nanoseconds of func, which processes n elements
+// per call
+template <typename F>
+double time_per_element (long n, F func) {
+  // Repeat until we have at least 0.2 seconds of timing
+  long reps = 0;
+  double elapsed = 0.0;
+  auto start = std::chrono::steady_clock::now();
+  while (elapsed < 0.2) {
+    func();
+    ++reps;
+    elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+  return 1e9 * elapsed / (reps * n);
+}
+
+inline void report (const char* name, double ns) {
+  std::printf("%-32s %10.2f ns/element %10.2f Melements/s\n", name, ns, 1e3 / ns);
+}
+
+#endif
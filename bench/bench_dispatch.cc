@@ -0,0 +1,125 @@
+// Throughput of the kernels compiled for each instruction set level (see
+// dr25/kernels.h). Unlike the other benchmarks this target is built without
+// -march=native, the same way as the extension, and it also checks that
+// every level agrees with the generic one.
+//
+//   cmake -S bench -B build/bench && cmake --build build/bench
+//   ./build/bench/bench_dispatch
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include "kernels.h"
+#include "interp.h"
+#include "bench.h"
+
+template <typename T>
+void bench_table (const batman::kernel_table<T>& kernels, const std::vector<T>& c1,
+                  const std::vector<T>& c2, const std::vector<T>& p, const std::vector<T>& z,
+                  const std::vector<T>& ref) {
+  const int n = int(z.size());
+  std::vector<T> flux(n), dc1(n), dc2(n), dp(n), dz(n);
+
+  std::printf("## %s\n", kernels.isa);
+  volatile T sink;
+  report("quad_batch", time_per_element(n, [&]() {
+    kernels.quad_batch(0, n, 1, c1.data(), c2.data(), p.data(), z.data(), flux.data());
+    sink = flux[n-1];
+  }));
+  report("quad_bucketed", time_per_element(n, [&]() {
+    kernels.quad_bucketed(0, n, 1, c1.data(), c2.data(), p.data(), z.data(), flux.data());
+    sink = flux[n-1];
+  }));
+  double diff = 0.0;
+  for (int i = 0; i < n; ++i) diff = std::max(diff, std::abs(double(flux[i]) - double(ref[i])));
+  report("quad_grad", time_per_element(n, [&]() {
+    kernels.quad_grad(0, n, 1, c1.data(), c2.data(), p.data(), z.data(),
+                      flux.data(), dc1.data(), dc2.data(), dp.data(), dz.data());
+    sink = flux[n-1];
+  }));
+
+  // The production Interp size: 14 CDPP durations
+  const long M = 1 << 20;
+  const std::vector<T> x = {1.5, 2.0, 2.5, 3.0, 3.5, 4.5, 5.0, 6.0, 7.5, 9.0, 10.5, 12.0, 12.5, 15.0};
+  const long N = long(x.size());
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> ut(0.5, 16.0), uy(20.0, 200.0), uu(0.0, 1.0);
+  std::vector<T> t(M), y(M * N), zi(M), dzi(M);
+  for (auto& v : t) v = T(ut(rng));
+  for (auto& v : y) v = T(uy(rng));
+  report("interp (scan)", time_per_element(M, [&]() {
+    kernels.interp(batman::INTERP_SEARCH_SCAN, 0, M, N, x.data(), t.data(), y.data(), zi.data(), dzi.data());
+    sink = zi[M-1];
+  }));
+
+  // Kepler long cadence for 256 stars over 80 days, supersampled 15 times
+  const long S = 256, C = 4096;
+  const T texp = T(0.0204);
+  std::uniform_real_distribution<double> ulogP(0.0, std::log(100.0));
+  std::vector<T> t0(S), period(S), a(S), b(S), tc(S * C), ftc(S * C);
+  for (long s = 0; s < S; ++s) {
+    period[s] = T(std::exp(ulogP(rng)));
+    t0[s] = T(period[s] * uu(rng));
+    a[s] = T(215.0 * std::pow(period[s] / 365.25, 2.0 / 3.0));
+    b[s] = T(uu(rng));
+    for (long m = 0; m < C; ++m) tc[s * C + m] = T(m * 0.0204);
+  }
+  report("transit (oversample 15)", time_per_element(S * C, [&]() {
+    kernels.transit(0, S * C, C, c1.data(), c2.data(), p.data(), t0.data(), period.data(),
+                    a.data(), b.data(), tc.data(), texp, 15, ftc.data());
+    sink = ftc[S * C - 1];
+  }));
+
+  // Separations on eccentric orbits at the same cadences
+  std::vector<T> ecc(S), omega(S), incl(S), kz(S * C * 7);
+  for (long s = 0; s < S; ++s) {
+    ecc[s] = T(0.9 * uu(rng));
+    omega[s] = T(2.0 * M_PI * uu(rng));
+    incl[s] = T(0.5 * M_PI - 0.05 * uu(rng));
+  }
+  T* kout = kz.data();
+  const long SC = S * C;
+  report("kepler", time_per_element(SC, [&]() {
+    kernels.kepler(0, SC, C, t0.data(), period.data(), ecc.data(), omega.data(), a.data(),
+                   incl.data(), tc.data(), kout, kout + SC, kout + 2 * SC, kout + 3 * SC,
+                   kout + 4 * SC, kout + 5 * SC, kout + 6 * SC);
+    sink = kout[SC - 1];
+  }));
+  (void)sink;
+  std::printf("  max |quad_bucketed - generic| = %g\n", diff);
+}
+
+template <typename T>
+void bench (const char* type_name) {
+  std::printf("# %s, selected: %s\n", type_name, batman::kernels<T>().isa);
+
+  // Transits of planets with p in [0.005, 0.3] across the full disk, with
+  // the generic result as the reference
+  const batman::kernel_table<T>* generic = batman::detail::kernels_generic<T>();
+  const int n = 1 << 14;
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> uu(0.0, 1.0);
+  std::vector<T> c1(n), c2(n), p(n), z(n), ref(n);
+  for (int i = 0; i < n; ++i) {
+    c1[i] = T(0.5 * uu(rng));
+    c2[i] = T(0.3 * uu(rng));
+    p[i] = T(0.005 + 0.295 * uu(rng));
+    z[i] = T(1.3 * uu(rng));
+  }
+  generic->quad_bucketed(0, n, 1, c1.data(), c2.data(), p.data(), z.data(), ref.data());
+
+  const batman::kernel_table<T>* tables[] = {
+    generic, batman::detail::kernels_avx2<T>(), batman::detail::kernels_avx512<T>()
+  };
+  for (const batman::kernel_table<T>* table : tables)
+    if (table != NULL) bench_table<T>(*table, c1, c2, p, z, ref);
+}
+
+int main () {
+  bench<double>("double");
+  bench<float>("float");
+  return 0;
+}
@@ -0,0 +1,92 @@
+// Throughput of the scalar and batch elliptic integrals and of the scalar,
+// batch and table quad kernels.
+//
+//   cmake -S bench -B build/bench && cmake --build build/bench
+//   ./build/bench/bench_ellint
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "quad_batch.h"
+#include "quad_table.h"
+#include "bench.h"
+
+template <typename T>
+void bench (const char* type_name) {
+  const int n = 1 << 14;
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> uk(0.0, 0.999), un(-0.9, 0.9);
+  std::vector<T> k(n), nu(n), out(n);
+  for (int i = 0; i < n; ++i) {
+    k[i] = T(uk(rng));
+    nu[i] = T(un(rng));
+  }
+
+  std::printf("# %s, %d lanes\n", type_name, batman::simd::packet<T>::size);
+
+  volatile T sink = T(0.0);
+  report("ellint_1", time_per_element(n, [&]() {
+    for (int i = 0; i < n; ++i) out[i] = batman::ellint_1(k[i]);
+    sink = out[n-1];
+  }));
+  report("ellint_1_batch", time_per_element(n, [&]() {
+    batman::ellint_1_batch(n, k.data(), out.data());
+    sink = out[n-1];
+  }));
+  report("ellint_2", time_per_element(n, [&]() {
+    for (int i = 0; i < n; ++i) out[i] = batman::ellint_2(k[i]);
+    sink = out[n-1];
+  }));
+  report("ellint_2_batch", time_per_element(n, [&]() {
+    batman::ellint_2_batch(n, k.data(), out.data());
+    sink = out[n-1];
+  }));
+  report("ellint_3", time_per_element(n, [&]() {
+    for (int i = 0; i < n; ++i) out[i] = batman::ellint_3(nu[i], k[i]);
+    sink = out[n-1];
+  }));
+  report("ellint_3_batch", time_per_element(n, [&]() {
+    batman::ellint_3_batch(n, nu.data(), k.data(), out.data());
+    sink = out[n-1];
+  }));
+  std::vector<T> out2(n), out3(n);
+  report("ellint_123", time_per_element(n, [&]() {
+    for (int i = 0; i < n; ++i) batman::ellint_123(nu[i], k[i], out[i], out2[i], out3[i]);
+    sink = out[n-1];
+  }));
+  report("ellint_123_batch", time_per_element(n, [&]() {
+    batman::ellint_123_batch(n, nu.data(), k.data(), out.data(), out2.data(), out3.data());
+    sink = out[n-1];
+  }));
+
+  // Transits of planets with p in [0.005, 0.3] across the full disk
+  std::uniform_real_distribution<double> up(0.005, 0.3), uz(0.0, 1.3), uc(0.0, 0.5);
+  std::vector<T> c1(n), c2(n), p(n), z(n);
+  for (int i = 0; i < n; ++i) {
+    c1[i] = T(uc(rng));
+    c2[i] = T(uc(rng));
+    p[i] = T(up(rng));
+    z[i] = T(uz(rng));
+  }
+  report("quad", time_per_element(n, [&]() {
+    for (int i = 0; i < n; ++i) out[i] = batman::quad(c1[i], c2[i], p[i], z[i]);
+    sink = out[n-1];
+  }));
+  report("quad_batch", time_per_element(n, [&]() {
+    batman::quad_batch<T>(0, n, 1, c1.data(), c2.data(), p.data(), z.data(), out.data());
+    sink = out[n-1];
+  }));
+  batman::QuadTable<T> table(T(0.005), T(0.3), 128, 256);
+  report("quad_table", time_per_element(n, [&]() {
+    for (int i = 0; i < n; ++i) out[i] = table(c1[i], c2[i], p[i], z[i]);
+    sink = out[n-1];
+  }));
+  (void)sink;
+}
+
+int main () {
+  bench<double>("double");
+  bench<float>("float");
+  return 0;
+}
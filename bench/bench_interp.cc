@@ -0,0 +1,92 @@
+// Throughput of the Interp search strategies against the binary search for
+// the production grid (the 14 Kepler CDPP durations) and for larger uniform
+// and log-uniform grids, with random and sorted queries.
+//
+//   cmake -S bench -B build/bench && cmake --build build/bench
+//   ./build/bench/bench_interp
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include "interp.h"
+#include "bench.h"
+
+template <typename T>
+void bench_grid (const char* name, const std::vector<T>& x, const std::vector<T>& t) {
+  static const char* methods[] = {"binary", "scan", "walk", "uniform", "log_uniform", "auto"};
+  const long M = long(t.size()), N = long(x.size());
+
+  // One row of y per query, like the CDPP table, but cycling through at most
+  // 2^24 values for the large grids
+  const long R = std::min(M, (1L << 24) / N);
+  std::vector<T> y(R * N), z(M), dz(M), ref(M);
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<double> uy(20.0, 200.0);
+  for (auto& v : y) v = T(uy(rng));
+
+  std::printf("## %s, N = %ld\n", name, N);
+  for (const char* method : methods) {
+    int m = batman::interp_search_method(method);
+    if (m == batman::INTERP_SEARCH_UNIFORM && !batman::interp_is_uniform(N, x.data())) continue;
+    if (m == batman::INTERP_SEARCH_LOG_UNIFORM && !batman::interp_is_log_uniform(N, x.data())) continue;
+    volatile T sink;
+    double ns = time_per_element(M, [&]() {
+      batman::InterpSearch<T> search(m, N, x.data());
+      for (long i = 0; i < M; ++i)
+        batman::interp_eval<T>(search, t[i], N, x.data(), y.data() + (i % R) * N, z[i], dz[i]);
+      sink = z[M-1];
+    });
+    (void)sink;
+    if (m == batman::INTERP_SEARCH_BINARY) ref = z;
+    for (long i = 0; i < M; ++i) {
+      if (z[i] != ref[i]) {
+        std::printf("  %s differs from binary at %ld\n", method, i);
+        break;
+      }
+    }
+    report(method, ns);
+  }
+}
+
+template <typename T>
+void bench (const char* type_name) {
+  const long M = 1 << 20;
+  std::mt19937 rng(42);
+  std::printf("# %s\n", type_name);
+
+  // The Kepler CDPP durations in hours
+  std::vector<T> durations = {1.5, 2.0, 2.5, 3.0, 3.5, 4.5, 5.0, 6.0, 7.5, 9.0, 10.5, 12.0, 12.5, 15.0};
+  std::uniform_real_distribution<double> ud(0.5, 16.0);
+  std::vector<T> t(M);
+  for (auto& v : t) v = T(ud(rng));
+  bench_grid<T>("durations, random queries", durations, t);
+  std::sort(t.begin(), t.end());
+  bench_grid<T>("durations, sorted queries", durations, t);
+
+  // Uniform grids
+  for (long N : {16L, 256L, 4096L}) {
+    std::vector<T> x(N);
+    for (long n = 0; n < N; ++n) x[n] = T(1.0 + 15.0 * n / (N - 1));
+    for (auto& v : t) v = T(ud(rng));
+    bench_grid<T>("uniform, random queries", x, t);
+  }
+
+  // Log-uniform grids
+  for (long N : {16L, 256L, 4096L}) {
+    std::vector<T> x(N);
+    for (long n = 0; n < N; ++n) x[n] = T(std::exp(std::log(1.0) + std::log(16.0) * n / (N - 1)));
+    for (auto& v : t) v = T(ud(rng));
+    bench_grid<T>("log-uniform, random queries", x, t);
+    std::sort(t.begin(), t.end());
+    bench_grid<T>("log-uniform, sorted queries", x, t);
+  }
+}
+
+int main () {
+  bench<double>("double");
+  bench<float>("float");
+  return 0;
+}
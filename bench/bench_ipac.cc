@@ -0,0 +1,95 @@
+// Throughput of the IPAC table reader on a synthetic table shaped like
+// q1_q17_dr25_stellar.txt (200000 rows of integer, real and string columns
+// with nulls): parsing on one and on all threads, writing the columnar
+// cache and mapping it again.
+//
+//   cmake -S bench -B build/bench && cmake --build build/bench
+//   ./build/bench/bench_ipac
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "ipac.h"
+#include "bench.h"
+
+// Write the table to path and return its size in bytes
+long write_stellar_table (const std::string& path, long rows) {
+  const int num_int = 4, num_double = 24, num_string = 4;
+  std::FILE* f = std::fopen(path.c_str(), "w");
+  std::fprintf(f, "\\fixlen = T\n\\ The synthetic stellar table of bench_ipac\n");
+  std::string names = "|", types = "|", units = "|", nulls = "|";
+  auto add = [&](const std::string& name, const char* type, int width) {
+    std::string pad(width - name.size(), ' ');
+    names += name + pad + "|";
+    types += type + std::string(width - std::string(type).size(), ' ') + "|";
+    units += std::string(width, ' ') + "|";
+    nulls += "null" + std::string(width - 4, ' ') + "|";
+  };
+  for (int k = 0; k < num_int; ++k) add("int" + std::to_string(k), "int", 10);
+  for (int k = 0; k < num_double; ++k) add("double" + std::to_string(k), "double", 14);
+  for (int k = 0; k < num_string; ++k) add("char" + std::to_string(k), "char", 12);
+  std::fprintf(f, "%s\n%s\n%s\n%s\n", names.c_str(), types.c_str(), units.c_str(), nulls.c_str());
+
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> u(0.0, 1.0);
+  for (long n = 0; n < rows; ++n) {
+    std::string line = " ";
+    char buffer[64];
+    for (int k = 0; k < num_int; ++k) {
+      std::snprintf(buffer, sizeof(buffer), "%10ld ", long(1e7 * u(rng)));
+      line += buffer;
+    }
+    for (int k = 0; k < num_double; ++k) {
+      if (u(rng) < 0.05) std::snprintf(buffer, sizeof(buffer), "%14s ", "null");
+      else std::snprintf(buffer, sizeof(buffer), "%14.6e ", 1e3 * (u(rng) - 0.5));
+      line += buffer;
+    }
+    for (int k = 0; k < num_string; ++k) {
+      std::snprintf(buffer, sizeof(buffer), "%12s ", ("q1_q17_" + std::to_string(k)).c_str());
+      line += buffer;
+    }
+    std::fprintf(f, "%s\n", line.c_str());
+  }
+  long size = std::ftell(f);
+  std::fclose(f);
+  return size;
+}
+
+int main () {
+  const long rows = 200000;
+  const std::string path = "/tmp/bench_ipac_" + std::to_string(::getpid()) + ".txt";
+  const std::string cache = path + ".cache";
+  const long size = write_stellar_table(path, rows);
+  std::printf("## IPAC table, %ld rows, %.1f MB\n", rows, 1e-6 * size);
+
+  volatile long sink;
+  report("ipac_read_1_thread", time_per_element(rows, [&]() {
+    batman::IpacTable table = batman::ipac_read(path, std::vector<std::string>(), 1);
+    sink = table.rows;
+  }));
+  batman::IpacTable table;
+  report("ipac_read", time_per_element(rows, [&]() {
+    table = batman::ipac_read(path, std::vector<std::string>(), 0);
+    sink = table.rows;
+  }));
+  const batman::IpacStamp stamp = batman::ipac_stamp(path);
+  report("ipac_write_cache", time_per_element(rows, [&]() {
+    batman::ipac_write_cache(table, stamp, cache);
+  }));
+  report("ipac_cache_column", time_per_element(rows, [&]() {
+    batman::IpacCache mapped(cache);
+    const double* x = reinterpret_cast<const double*>(mapped.data(5));
+    double total = 0.0;
+    for (long n = 0; n < mapped.rows(); ++n) total += (x[n] == x[n]) ? x[n] : 0.0;
+    sink = long(total);
+  }));
+  (void)sink;
+
+  std::remove(path.c_str());
+  std::remove(cache.c_str());
+  return 0;
+}
@@ -0,0 +1,94 @@
+// Throughput of the scalar, chunked batch and regime bucketed quad kernels
+// for workloads with different mixes of regimes.
+//
+//   cmake -S bench -B build/bench && cmake --build build/bench
+//   ./build/bench/bench_quad
+
+#include <cmath>
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "quad_batch.h"
+#include "quad_bucket.h"
+#include "bench.h"
+
+template <typename T>
+void bench_workload (const char* name, const std::vector<T>& c1, const std::vector<T>& c2,
+                     const std::vector<T>& p, const std::vector<T>& z) {
+  const int n = int(z.size());
+  std::vector<T> out(n), ref(n);
+  volatile T sink;
+  std::printf("## %s\n", name);
+  report("quad", time_per_element(n, [&]() {
+    for (int i = 0; i < n; ++i) out[i] = batman::quad(c1[i], c2[i], p[i], z[i]);
+    sink = out[n-1];
+  }));
+  report("quad_batch", time_per_element(n, [&]() {
+    batman::quad_batch<T>(0, n, 1, c1.data(), c2.data(), p.data(), z.data(), ref.data());
+    sink = ref[n-1];
+  }));
+  report("quad_bucketed", time_per_element(n, [&]() {
+    batman::quad_bucketed<T>(0, n, 1, c1.data(), c2.data(), p.data(), z.data(), out.data());
+    sink = out[n-1];
+  }));
+  (void)sink;
+  double diff = 0.0;
+  for (int i = 0; i < n; ++i) diff = std::max(diff, std::abs(double(out[i]) - double(ref[i])));
+  std::printf("  max |quad_bucketed - quad_batch| = %g\n", diff);
+}
+
+template <typename T>
+void bench (const char* type_name) {
+  const int n = 1 << 14;
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> up(0.005, 0.3), uc(0.0, 0.5);
+  std::vector<T> c1(n), c2(n), p(n), z(n);
+  for (int i = 0; i < n; ++i) {
+    c1[i] = T(uc(rng));
+    c2[i] = T(uc(rng));
+    p[i] = T(up(rng));
+  }
+
+  std::printf("# %s\n", type_name);
+
+  // Uniform over the disk: inside, limb crossing and out of transit mixed
+  // at random
+  std::uniform_real_distribution<double> uz(0.0, 1.3);
+  for (int i = 0; i < n; ++i) z[i] = T(uz(rng));
+  bench_workload<T>("random z in [0, 1.3]", c1, c2, p, z);
+
+  // Mostly out of transit, like a sparsely sampled light curve
+  std::uniform_real_distribution<double> uw(0.0, 5.0);
+  for (int i = 0; i < n; ++i) z[i] = T(uw(rng));
+  bench_workload<T>("random z in [0, 5]", c1, c2, p, z);
+
+  // The same planet along a densely sampled transit chord so that
+  // neighbouring elements are usually in the same regime
+  for (int i = 0; i < n; ++i) {
+    T t = T(-1.5 + 3.0 * i / (n - 1));
+    z[i] = std::sqrt(t * t + T(0.09));
+    p[i] = T(0.1);
+  }
+  bench_workload<T>("ordered transit chord", c1, c2, p, z);
+
+  // Every regime including the d == p and d == 1 - p corner cases
+  std::uniform_real_distribution<double> uu(0.0, 1.0);
+  for (int i = 0; i < n; ++i) {
+    T pi = T(0.005 + 1.5 * uu(rng));
+    p[i] = pi;
+    switch (i % 5) {
+      case 0: z[i] = pi; break;
+      case 1: z[i] = std::abs(T(1.0) - pi); break;
+      default: z[i] = T(2.0 * uu(rng));
+    }
+  }
+  bench_workload<T>("all regimes with corner cases", c1, c2, p, z);
+}
+
+int main () {
+  bench<double>("double");
+  bench<float>("float");
+  return 0;
+}
@@ -0,0 +1,331 @@
+// The reference workloads for performance work on the kernels behind the
+// ops:
+//
+//   1. batman::quad in each geometric regime (scalar, batch and bucketed)
+//   2. the complete elliptic integrals across ranges of the modulus
+//   3. the gradient of quad as used by QuadRev: the closed form quad_grad
+//      and the AutoDiff path through ellint_grad.h (if Eigen was found)
+//   4. Interp at the production size of the completeness notebooks: 10^6
+//      queries against the 14 CDPP durations
+//   5. the fused detection probability (and its gradient) at the same size
+//   6. the streaming expected number of detections over 10^6 samples drawn
+//      around 1000 stars, pseudo-random and scrambled Sobol
+//
+//   cmake -S bench -B build/bench && cmake --build build/bench
+//   ./build/bench/bench_suite
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include "quad_batch.h"
+#include "quad_bucket.h"
+#include "quad_grad.h"
+#include "interp.h"
+#include "detection.h"
+#include "expected.h"
+#ifdef DR25_BENCH_AUTODIFF
+#include "ellint_grad.h"
+#endif
+#include "bench.h"
+
+// Inputs for quad that all fall in one regime
+template <typename T>
+struct regime_inputs {
+  regime_inputs (const char* name, int regime) : name(name), regime(regime) {}
+  const char* name;
+  int regime;
+  std::vector<T> c1, c2, p, z;
+};
+
+template <typename T>
+std::vector<regime_inputs<T> > make_regime_inputs (int n) {
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> uu(0.0, 1.0);
+  auto lerp = [&](double a, double b) { return a + (b - a) * uu(rng); };
+
+  std::vector<regime_inputs<T> > inputs = {
+    {"unocculted", batman::QUAD_UNOCCULTED},
+    {"occulted", batman::QUAD_OCCULTED},
+    {"edge_inner (d == p < 0.5)", batman::QUAD_EDGE_INNER},
+    {"edge_outer (d == p > 0.5)", batman::QUAD_EDGE_OUTER},
+    {"limb", batman::QUAD_LIMB},
+    {"inside", batman::QUAD_INSIDE}
+  };
+  for (auto& in : inputs) {
+    for (int i = 0; i < n; ++i) {
+      double p = lerp(0.005, 0.3), z = 0.0;
+      switch (in.regime) {
+        case batman::QUAD_UNOCCULTED: z = lerp(1.0 + p + 1e-3, 5.0); break;
+        case batman::QUAD_OCCULTED: p = lerp(1.1, 1.5); z = lerp(0.0, p - 1.0 - 1e-3); break;
+        case batman::QUAD_EDGE_INNER: z = p; break;
+        case batman::QUAD_EDGE_OUTER: p = lerp(0.55, 1.5); z = p; break;
+        case batman::QUAD_LIMB: z = lerp(1.0 - p + 1e-3, 1.0 + p - 1e-3); break;
+        case batman::QUAD_INSIDE: z = lerp(1e-3, 1.0 - p - 1e-3); break;
+      }
+      in.c1.push_back(T(lerp(0.0, 0.5)));
+      in.c2.push_back(T(lerp(0.0, 0.3)));
+      in.p.push_back(T(p));
+      in.z.push_back(T(z));
+    }
+
+    // Rounding to float can move a few points across a boundary
+    int wrong = 0;
+    for (int i = 0; i < n; ++i)
+      wrong += batman::quad_regime(in.p[i], batman::quad_separation(in.p[i], in.z[i])) != in.regime;
+    if (wrong) std::printf("  (%d of %d %s inputs are in a different regime)\n", wrong, n, in.name);
+  }
+  return inputs;
+}
+
+template <typename T>
+void bench_quad_regimes (int n) {
+  std::vector<T> out(n);
+  volatile T sink;
+  for (const auto& in : make_regime_inputs<T>(n)) {
+    const T *c1 = in.c1.data(), *c2 = in.c2.data(), *p = in.p.data(), *z = in.z.data();
+    std::printf("## quad, %s\n", in.name);
+    report("quad", time_per_element(n, [&]() {
+      for (int i = 0; i < n; ++i) out[i] = batman::quad(c1[i], c2[i], p[i], z[i]);
+      sink = out[n-1];
+    }));
+    report("quad_batch", time_per_element(n, [&]() {
+      batman::quad_batch<T>(0, n, 1, c1, c2, p, z, out.data());
+      sink = out[n-1];
+    }));
+    report("quad_bucketed", time_per_element(n, [&]() {
+      batman::quad_bucketed<T>(0, n, 1, c1, c2, p, z, out.data());
+      sink = out[n-1];
+    }));
+  }
+  (void)sink;
+}
+
+template <typename T>
+void bench_ellint_ranges (int n) {
+  static const double ranges[][2] = {
+    {0.0, 0.5}, {0.5, 0.9}, {0.9, 0.99}, {0.99, 0.9999}, {0.9999, 1.0 - 1e-6}
+  };
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> uu(0.0, 1.0);
+  std::vector<T> k(n), nu(n), K(n), E(n), P(n);
+  for (int i = 0; i < n; ++i) nu[i] = T(0.9 * uu(rng));
+
+  volatile T sink;
+  for (const auto& range : ranges) {
+    for (int i = 0; i < n; ++i) k[i] = T(range[0] + (range[1] - range[0]) * uu(rng));
+    std::printf("## ellint, k in [%g, %g)\n", range[0], range[1]);
+    report("ellint_1", time_per_element(n, [&]() {
+      for (int i = 0; i < n; ++i) K[i] = batman::ellint_1(k[i]);
+      sink = K[n-1];
+    }));
+    report("ellint_2", time_per_element(n, [&]() {
+      for (int i = 0; i < n; ++i) E[i] = batman::ellint_2(k[i]);
+      sink = E[n-1];
+    }));
+    report("ellint_3", time_per_element(n, [&]() {
+      for (int i = 0; i < n; ++i) P[i] = batman::ellint_3(nu[i], k[i]);
+      sink = P[n-1];
+    }));
+    report("ellint_123", time_per_element(n, [&]() {
+      for (int i = 0; i < n; ++i) batman::ellint_123(nu[i], k[i], K[i], E[i], P[i]);
+      sink = P[n-1];
+    }));
+    report("ellint_123_batch", time_per_element(n, [&]() {
+      batman::ellint_123_batch(n, nu.data(), k.data(), K.data(), E.data(), P.data());
+      sink = P[n-1];
+    }));
+  }
+  (void)sink;
+}
+
+template <typename T>
+void bench_quad_grad (int n) {
+  std::vector<T> out(n), dc1(n), dc2(n), dp(n), dz(n);
+  volatile T sink;
+  for (const auto& in : make_regime_inputs<T>(n)) {
+    const T *c1 = in.c1.data(), *c2 = in.c2.data(), *p = in.p.data(), *z = in.z.data();
+    std::printf("## gradient of quad, %s\n", in.name);
+    report("quad_grad", time_per_element(n, [&]() {
+      for (int i = 0; i < n; ++i)
+        out[i] = batman::quad_grad(c1[i], c2[i], p[i], z[i], dc1[i], dc2[i], dp[i], dz[i]);
+      sink = out[n-1];
+    }));
+#ifdef DR25_BENCH_AUTODIFF
+    typedef Eigen::AutoDiffScalar<Eigen::Matrix<T, 4, 1> > AD;
+    std::vector<AD, Eigen::aligned_allocator<AD> > ad(n);
+    report("quad (AutoDiff)", time_per_element(n, [&]() {
+      for (int i = 0; i < n; ++i)
+        ad[i] = batman::quad(AD(c1[i], 4, 0), AD(c2[i], 4, 1), AD(p[i], 4, 2), AD(z[i], 4, 3));
+      sink = ad[n-1].value();
+    }));
+
+    // In double the two agree to rounding; in float the derivatives of
+    // the Pi term are ill-conditioned near d ~ p and differ by more
+    double diff = 0.0;
+    for (int i = 0; i < n; ++i) {
+      const T grad[] = {dc1[i], dc2[i], dp[i], dz[i]};
+      for (int j = 0; j < 4; ++j)
+        diff = std::max(diff, std::abs(double(grad[j]) - double(ad[i].derivatives()(j))));
+    }
+    std::printf("  max |quad_grad - AutoDiff| = %g\n", diff);
+#endif
+  }
+  (void)sink;
+}
+
+template <typename T>
+void bench_interp_production () {
+  // The notebooks draw 10^6 planets, each with the 14 CDPP values of its
+  // star, and interpolate at the transit duration
+  const long M = 1000000, S = 200000;
+  const std::vector<T> x = {1.5, 2.0, 2.5, 3.0, 3.5, 4.5, 5.0, 6.0, 7.5, 9.0, 10.5, 12.0, 12.5, 15.0};
+  const long N = long(x.size());
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> ut(0.5, 16.0), uy(20.0, 200.0);
+  std::uniform_int_distribution<long> us(0, S - 1);
+  std::vector<T> t(M), y(M * N), table(S * N), z(M), dz(M), w(M), dw(M);
+  std::vector<long> rows(M);
+  std::vector<std::int64_t> index(M);
+  for (auto& v : t) v = T(ut(rng));
+  for (auto& v : y) v = T(uy(rng));
+  for (auto& v : table) v = T(uy(rng));
+  for (auto& v : rows) v = us(rng);
+
+  volatile T sink;
+  std::printf("## Interp, M = %ld queries, N = %ld\n", M, N);
+  report("interp (per-query rows)", time_per_element(M, [&]() {
+    batman::InterpSearch<T> search(batman::INTERP_SEARCH_AUTO, N, x.data());
+    for (long m = 0; m < M; ++m)
+      batman::interp_eval<T>(search, t[m], N, x.data(), y.data() + m * N, z[m], dz[m]);
+    sink = z[M-1];
+  }));
+  report("interp_gather", time_per_element(M, [&]() {
+    batman::InterpSearch<T> search(batman::INTERP_SEARCH_AUTO, N, x.data());
+    for (long m = 0; m < M; ++m)
+      batman::interp_eval<T>(search, t[m], N, x.data(), table.data() + rows[m] * N, z[m], dz[m]);
+    sink = z[M-1];
+  }));
+  report("interp_index", time_per_element(M, [&]() {
+    batman::InterpSearch<T> search(batman::INTERP_SEARCH_AUTO, N, x.data());
+    for (long m = 0; m < M; ++m)
+      batman::interp_index_eval<T>(search, t[m], N, x.data(), index[m], w[m], dw[m]);
+    sink = w[M-1];
+  }));
+  report("interp_apply", time_per_element(M, [&]() {
+    for (long m = 0; m < M; ++m)
+      z[m] = batman::interp_apply_eval<T>(index[m], w[m], y.data() + m * N);
+    sink = z[M-1];
+  }));
+  (void)sink;
+}
+
+template <typename T>
+void bench_detection_production () {
+  // The simulated planets of simple.ipynb around random Sun-like stars
+  const long M = 1000000;
+  const std::vector<T> x = {1.5, 2.0, 2.5, 3.0, 3.5, 4.5, 5.0, 6.0, 7.5, 9.0, 10.5, 12.0, 12.5, 15.0};
+  const long N = long(x.size());
+  const batman::DetectionModel<T> model = {T(0.95), {T(9.96), T(0.276), T(-5.70)}, {T(-2.04), T(-1.03), T(1.21)}};
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> uu(0.0, 1.0), uy(20.0, 200.0);
+  std::vector<batman::DetectionSample<T> > samples(M);
+  std::vector<T> cdpp(M * N), pdet(M);
+  for (auto& v : cdpp) v = T(uy(rng));
+  for (long m = 0; m < M; ++m) {
+    batman::DetectionSample<T>& s = samples[m];
+    s.r_star = T(0.8 + 0.4 * uu(rng));
+    s.logg_star = T(4.3 + 0.3 * uu(rng));
+    s.g1 = T(0.4 + 0.1 * uu(rng));
+    s.g2 = T(0.2 + 0.1 * uu(rng));
+    s.dataspan = T(1400.0);
+    s.dutycycle = T(0.7 + 0.2 * uu(rng));
+    s.r_pl = T(std::exp(std::log(0.7) + (std::log(15.0) - std::log(0.7)) * uu(rng)));
+    s.period = T(std::exp(std::log(100.0) * uu(rng)));
+    s.b = T(uu(rng));
+    s.cdpp = cdpp.data() + m * N;
+  }
+
+  volatile T sink;
+  std::printf("## DetectionProbability, M = %ld samples\n", M);
+  report("detection_probability", time_per_element(M, [&]() {
+    batman::InterpSearch<T> search(batman::INTERP_SEARCH_AUTO, N, x.data());
+    for (long m = 0; m < M; ++m)
+      pdet[m] = batman::detection_probability<T>(model, search, N, x.data(), samples[m]);
+    sink = pdet[M-1];
+  }));
+  report("detection_probability_grad", time_per_element(M, [&]() {
+    batman::InterpSearch<T> search(batman::INTERP_SEARCH_AUTO, N, x.data());
+    batman::DetectionGrad<T> grad;
+    for (long m = 0; m < M; ++m)
+      pdet[m] = batman::detection_probability_grad<T>(model, search, N, x.data(), samples[m], grad);
+    sink = pdet[M-1] + grad.r_star;
+  }));
+  (void)sink;
+}
+
+template <typename T>
+void bench_expected_production () {
+  // The population integral of simple.ipynb with Nint = 10^6 around a
+  // catalog of random Sun-like stars
+  const long M = 1000000, S = 1000;
+  const std::vector<T> x = {1.5, 2.0, 2.5, 3.0, 3.5, 4.5, 5.0, 6.0, 7.5, 9.0, 10.5, 12.0, 12.5, 15.0};
+  const long N = long(x.size());
+  const batman::DetectionModel<T> model = {T(0.95), {T(9.96), T(0.276), T(-5.70)}, {T(-2.04), T(-1.03), T(1.21)}};
+  const batman::ExpectedRate<T> rate = {T(-3.0), T(0.0), T(-1.5)};
+  const batman::ExpectedBox<T> box = {T(1.0), T(400.0), T(0.7), T(15.0)};
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> uu(0.0, 1.0), uy(20.0, 200.0);
+  std::vector<T> r_star(S), logg_star(S), g1(S), g2(S), dataspan(S), dutycycle(S), cdpp(S * N);
+  for (auto& v : cdpp) v = T(uy(rng));
+  for (long s = 0; s < S; ++s) {
+    r_star[s] = T(0.8 + 0.4 * uu(rng));
+    logg_star[s] = T(4.3 + 0.3 * uu(rng));
+    g1[s] = T(0.4 + 0.1 * uu(rng));
+    g2[s] = T(0.2 + 0.1 * uu(rng));
+    dataspan[s] = T(1400.0);
+    dutycycle[s] = T(0.7 + 0.2 * uu(rng));
+  }
+  const batman::ExpectedStars<T> stars = {
+    S, r_star.data(), logg_star.data(), g1.data(), g2.data(), cdpp.data(), dataspan.data(), dutycycle.data()
+  };
+
+  volatile double sink;
+  std::printf("## ExpectedDetections, %ld samples, S = %ld stars\n", M, S);
+  const batman::ExpectedRandom random = {42};
+  report("expected_accumulate", time_per_element(M, [&]() {
+    batman::InterpSearch<T> search(batman::INTERP_SEARCH_AUTO, N, x.data());
+    batman::ExpectedSum sum;
+    batman::expected_accumulate<T>(model, rate, box, stars, search, N, x.data(), random, 0, M, sum);
+    sink = sum.value[0] * batman::expected_norm<T>(box, S, M);
+  }));
+  const batman::SobolSequence sequence(4, 42);
+  const batman::ExpectedSobol sobol = {sequence};
+  report("expected_accumulate_sobol", time_per_element(M, [&]() {
+    batman::InterpSearch<T> search(batman::INTERP_SEARCH_AUTO, N, x.data());
+    batman::ExpectedSum sum;
+    batman::expected_accumulate<T>(model, rate, box, stars, search, N, x.data(), sobol, 0, M, sum);
+    sink = sum.value[0] * batman::expected_norm<T>(box, S, M);
+  }));
+  (void)sink;
+}
+
+template <typename T>
+void bench (const char* type_name) {
+  const int n = 1 << 14;
+  std::printf("# %s\n", type_name);
+  bench_quad_regimes<T>(n);
+  bench_ellint_ranges<T>(n);
+  bench_quad_grad<T>(n);
+  bench_interp_production<T>();
+  bench_detection_production<T>();
+  bench_expected_production<T>();
+}
+
+int main () {
+  bench<double>("double");
+  bench<float>("float");
+  return 0;
+}
@@ -0,0 +1,282 @@
+#ifndef _DR25_DETECTION_H_
+#define _DR25_DETECTION_H_
+
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include "quad.h"
+#include "quad_grad.h"
+#include "interp.h"
+
+namespace batman {
+
+  using std::abs;
+  using std::exp;
+  using std::log;
+  using std::pow;
+  using std::cbrt;
+  using std::sqrt;
+  using std::asin;
+
+  // The detection probability of a simulated planet as computed by the
+  // completeness model in simple.ipynb: the durations of the transit follow
+  // from a circular orbit around a star of the given radius and surface
+  // gravity, the depth from the quadratic limb darkening model and the
+  // noise from the CDPP of the star interpolated at the full duration. The
+  // multiple event statistic
+  //
+  //   mes = sqrt(dataspan * dutycycle / period) * depth / cdpp
+  //
+  // sets the completeness through a logistic function of log(mes) whose
+  // center mes0 and log width are quadratic in the transit shape
+  // tau_full / tau_tot:
+  //
+  //   pdet = comp_norm / (1 + exp(-(log(mes) - log(mes0)) * exp(-log_sig_mes)))
+  //
+  // clipped to [0, 1]. The clipping matches the notebook, including the
+  // zero derivatives where a value is clipped.
+
+  // The hyperparameters of the completeness model
+  template <typename T>
+  struct DetectionModel {
+    T comp_norm;
+    T mes0[3];
+    T log_sig_mes[3];
+  };
+
+  // The properties of one simulated planet and its star; the planet radius
+  // is in Earth radii, the star radius in solar radii, the times in days and
+  // cdpp is the row of the CDPP table (in ppm) for the star
+  template <typename T>
+  struct DetectionSample {
+    T r_star, logg_star, g1, g2, dataspan, dutycycle, r_pl, period, b;
+    const T* cdpp;
+  };
+
+  // The partial derivatives of the detection probability for one sample.
+  // The derivative with respect to the CDPP row is non-zero for the two
+  // nodes cdpp_index and cdpp_index + 1 only.
+  template <typename T>
+  struct DetectionGrad {
+    T r_star, logg_star, g1, g2, dataspan, dutycycle, r_pl, period, b;
+    std::int64_t cdpp_index;
+    T cdpp_left, cdpp_right;
+    DetectionModel<T> model;
+  };
+
+  namespace detail {
+
+    // The values and clipping of one duration, tau = period * asin(u) / pi
+    // with u = r_star * sqrt(A) / a sin(i) and A = (1 +/- ror)^2 - b^2
+    template <typename T>
+    struct DetectionDuration {
+      T A, sqrtA, u, tau;
+      bool A_clipped, u_clipped;
+
+      DetectionDuration (const T& A0, const T& r_star, const T& asini, const T& period) {
+        const T u_max = T(1.0 - 1.0e-5);
+        A_clipped = !(A0 > T(0.0));
+        A = A_clipped ? T(0.0) : A0;
+        sqrtA = sqrt(A);
+        u = r_star * sqrtA / asini;
+        u_clipped = !(u > -u_max && u < u_max);
+        if (u_clipped) u = (u < T(0.0)) ? -u_max : u_max;
+        tau = period * asin(u) / T(M_PI);
+      }
+
+      // Propagate the adjoint btau to r_star, A and asini; adds to the
+      // period directly
+      void backward (const T& btau, const T& r_star, const T& asini, const T& period,
+                     T& br_star, T& bA, T& basini, T& bperiod) const {
+        bperiod += btau * asin(u) / T(M_PI);
+        bA = T(0.0);
+        if (u_clipped) return;
+        T bu = btau * period / (T(M_PI) * sqrt(T(1.0) - u * u));
+        br_star += bu * sqrtA / asini;
+        basini -= bu * u / asini;
+        if (!A_clipped) bA = bu * r_star / (T(2.0) * sqrtA * asini);
+      }
+    };
+
+    // Every intermediate of the forward pass that the gradient needs; with
+    // grad the partials of the flux are computed along with it
+    template <typename T>
+    struct DetectionForward {
+      // The clipping flags are declared before the values that they select
+      // since the members are initialized in this order
+      T ror, M_star, a0;
+      bool a_clipped;
+      T a, arg;
+      bool arg_clipped;
+      T asini;
+      DetectionDuration<T> tot, full;
+      T shape, flux, flux_g1, flux_g2, flux_ror, flux_b, depth, mes0, log_sig_mes;
+      std::int64_t cdpp_index;
+      T cdpp_weight, cdpp_dweight, cdpp;
+      T ntran, mes, L, s, q, D, pdet_raw, pdet;
+
+      template <typename Search>
+      DetectionForward (const DetectionModel<T>& model, Search& search, std::int64_t N,
+                        const T* x, const DetectionSample<T>& sample, bool grad)
+        : ror(T(0.009158) * sample.r_pl / sample.r_star),
+          M_star(exp(T(M_LN10) * (sample.logg_star - T(4.437))) * sample.r_star * sample.r_star),
+          a0(T(215.0) * cbrt(M_star * (sample.period / T(365.25)) * (sample.period / T(365.25)))),
+          a_clipped(a0 < sample.r_star), a(a_clipped ? sample.r_star : a0),
+          arg(a * a - sample.r_star * sample.b * sample.r_star * sample.b),
+          arg_clipped(!(arg > T(0.0))), asini(arg_clipped ? T(0.0) : sqrt(arg)),
+          tot((T(1.0) + ror) * (T(1.0) + ror) - sample.b * sample.b, sample.r_star, asini, sample.period),
+          full((T(1.0) - ror) * (T(1.0) - ror) - sample.b * sample.b, sample.r_star, asini, sample.period)
+      {
+        shape = full.tau / tot.tau;
+        if (grad) {
+          flux = quad_grad<T>(sample.g1, sample.g2, ror, sample.b, flux_g1, flux_g2, flux_ror, flux_b);
+        } else {
+          flux = quad<T>(sample.g1, sample.g2, ror, sample.b);
+          flux_g1 = flux_g2 = flux_ror = flux_b = T(0.0);
+        }
+        depth = (T(1.0) - flux) * T(1.0e6);
+
+        const T x2 = shape * shape;
+        mes0 = model.mes0[0] + model.mes0[1] * shape + model.mes0[2] * x2;
+        log_sig_mes = model.log_sig_mes[0] + model.log_sig_mes[1] * shape + model.log_sig_mes[2] * x2;
+
+        interp_index_eval<T>(search, full.tau, N, x, cdpp_index, cdpp_weight, cdpp_dweight);
+        cdpp = interp_apply_eval<T>(cdpp_index, cdpp_weight, sample.cdpp);
+
+        ntran = sample.dataspan * sample.dutycycle / sample.period;
+        mes = sqrt(ntran) * depth / cdpp;
+
+        L = log(mes) - log(mes0);
+        s = exp(-log_sig_mes);
+        q = exp(-L * s);
+        D = T(1.0) + q;
+        pdet_raw = model.comp_norm / D;
+        pdet = std::max(T(0.0), std::min(T(1.0), pdet_raw));
+      }
+    };
+
+  }
+
+  // The clipped detection probability of one sample; search must be a
+  // search over the N durations x that the CDPP rows are given at
+  template <typename T, typename Search>
+  T detection_probability (const DetectionModel<T>& model, Search& search, std::int64_t N,
+                           const T* x, const DetectionSample<T>& sample) {
+    return detail::DetectionForward<T>(model, search, N, x, sample, false).pdet;
+  }
+
+  // The detection probability and its partial derivatives with respect to
+  // the sample and the hyperparameters
+  template <typename T, typename Search>
+  T detection_probability_grad (const DetectionModel<T>& model, Search& search, std::int64_t N,
+                                const T* x, const DetectionSample<T>& sample,
+                                DetectionGrad<T>& grad) {
+    const detail::DetectionForward<T> f(model, search, N, x, sample, true);
+
+    grad.r_star = grad.logg_star = grad.g1 = grad.g2 = grad.dataspan = grad.dutycycle = T(0.0);
+    grad.r_pl = grad.period = grad.b = T(0.0);
+    grad.cdpp_index = f.cdpp_index;
+    grad.cdpp_left = grad.cdpp_right = T(0.0);
+    grad.model.comp_norm = T(0.0);
+    for (int k = 0; k < 3; ++k) grad.model.mes0[k] = grad.model.log_sig_mes[k] = T(0.0);
+
+    // Clipped, or no transit at all (mes = 0 so pdet = 0 for any nearby
+    // parameters)
+    if (!(f.pdet_raw >= T(0.0) && f.pdet_raw <= T(1.0))) return f.pdet;
+    if (!(f.mes > T(0.0))) return f.pdet;
+
+    // The logistic function
+    const T D2 = f.D * f.D;
+    const T pdet_L = model.comp_norm * f.q * f.s / D2;
+    const T bmes = pdet_L / f.mes, bmes0 = -pdet_L / f.mes0;
+    const T blog_sig_mes = -model.comp_norm * f.q * f.L * f.s / D2;
+    grad.model.comp_norm = T(1.0) / f.D;
+    T xk = T(1.0);
+    for (int k = 0; k < 3; ++k) {
+      grad.model.mes0[k] = bmes0 * xk;
+      grad.model.log_sig_mes[k] = blog_sig_mes * xk;
+      xk *= f.shape;
+    }
+    const T bshape = bmes0 * (model.mes0[1] + T(2.0) * model.mes0[2] * f.shape)
+                   + blog_sig_mes * (model.log_sig_mes[1] + T(2.0) * model.log_sig_mes[2] * f.shape);
+
+    // The multiple event statistic
+    const T bdepth = bmes * f.mes / f.depth;
+    const T bcdpp = -bmes * f.mes / f.cdpp;
+    const T bntran = bmes * f.mes / (T(2.0) * f.ntran);
+    grad.dataspan = bntran * sample.dutycycle / sample.period;
+    grad.dutycycle = bntran * sample.dataspan / sample.period;
+    grad.period -= bntran * f.ntran / sample.period;
+
+    // The CDPP interpolated at the full duration
+    grad.cdpp_left = bcdpp * (T(1.0) - f.cdpp_weight);
+    grad.cdpp_right = bcdpp * f.cdpp_weight;
+    T btau_full = bcdpp * (sample.cdpp[f.cdpp_index + 1] - sample.cdpp[f.cdpp_index]) * f.cdpp_dweight;
+
+    // The depth
+    const T bflux = -bdepth * T(1.0e6);
+    grad.g1 = bflux * f.flux_g1;
+    grad.g2 = bflux * f.flux_g2;
+    T bror = bflux * f.flux_ror;
+    grad.b = bflux * f.flux_b;
+
+    // The shape and the two durations
+    btau_full += bshape / f.tot.tau;
+    const T btau_tot = -bshape * f.full.tau / (f.tot.tau * f.tot.tau);
+    T bA_tot, bA_full, basini = T(0.0);
+    f.tot.backward(btau_tot, sample.r_star, f.asini, sample.period,
+                   grad.r_star, bA_tot, basini, grad.period);
+    f.full.backward(btau_full, sample.r_star, f.asini, sample.period,
+                    grad.r_star, bA_full, basini, grad.period);
+    bror += T(2.0) * (bA_tot * (T(1.0) + f.ror) - bA_full * (T(1.0) - f.ror));
+    grad.b -= T(2.0) * sample.b * (bA_tot + bA_full);
+
+    // a sin(i) and the semi-major axis
+    T ba = T(0.0);
+    if (!f.arg_clipped) {
+      const T barg = basini / (T(2.0) * f.asini);
+      const T rb = sample.r_star * sample.b;
+      ba = barg * T(2.0) * f.a;
+      grad.r_star -= barg * T(2.0) * rb * sample.b;
+      grad.b -= barg * T(2.0) * rb * sample.r_star;
+    }
+    if (f.a_clipped) {
+      grad.r_star += ba;
+    } else {
+      const T bM_star = ba * f.a0 / (T(3.0) * f.M_star);
+      grad.period += ba * T(2.0) * f.a0 / (T(3.0) * sample.period);
+      grad.logg_star = bM_star * f.M_star * T(M_LN10);
+      grad.r_star += bM_star * T(2.0) * f.M_star / sample.r_star;
+    }
+
+    // The radius ratio
+    grad.r_pl = bror * T(0.009158) / sample.r_star;
+    grad.r_star -= bror * f.ror / sample.r_star;
+
+    return f.pdet;
+  }
+
+  // The factors of the total detection probability in simple.ipynb that
+  // don't depend on the completeness model: the window function (the
+  // probability of observing at least three transits in dataspan with the
+  // duty cycle dutycycle) and the geometric transit probability r_star / a.
+  template <typename T>
+  T detection_window (const DetectionSample<T>& sample) {
+    const T M = sample.dataspan / sample.period, f = sample.dutycycle, omf = T(1.0) - f;
+    if (!(M >= T(2.0))) return T(0.0);
+    const T omf_m2 = pow(omf, M - T(2.0));
+    const T pw = T(1.0) - omf_m2 * omf * omf - M * f * omf_m2 * omf - T(0.5) * M * (M - T(1.0)) * f * f * omf_m2;
+    return (pw >= T(0.0)) ? pw : T(0.0);
+  }
+
+  template <typename T>
+  T detection_geometric (const DetectionSample<T>& sample) {
+    const T M_star = exp(T(M_LN10) * (sample.logg_star - T(4.437))) * sample.r_star * sample.r_star;
+    const T a = T(215.0) * cbrt(M_star * (sample.period / T(365.25)) * (sample.period / T(365.25)));
+    if (!(a > sample.r_star)) return T(1.0);
+    return sample.r_star / a;
+  }
+
+}
+
+#endif
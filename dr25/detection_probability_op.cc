@@ -0,0 +1,128 @@
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+#include "detection.h"
+
+using namespace tensorflow;
+
+// Rough cost (in cycles) of one sample: a call to batman::quad, the CDPP
+// search and a dozen transcendental functions for the durations and the
+// logistic function
+static const int64 kDetectionCostPerElement = 1500;
+
+REGISTER_OP("DetectionProbability")
+  .Attr("T: {float, double}")
+  .Input("comp_norm: T")
+  .Input("mes0: T")
+  .Input("log_sig_mes: T")
+  .Input("durations: T")
+  .Input("r_star: T")
+  .Input("logg_star: T")
+  .Input("g1: T")
+  .Input("g2: T")
+  .Input("cdpp: T")
+  .Input("dataspan: T")
+  .Input("dutycycle: T")
+  .Input("r_pl: T")
+  .Input("period: T")
+  .Input("b: T")
+  .Output("pdet: T")
+  .SetShapeFn([](shape_inference::InferenceContext* c) {
+    shape_inference::ShapeHandle s, h, x, cdpp;
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &h));
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &h));
+    TF_RETURN_IF_ERROR(c->Merge(h, c->input(2), &h));
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(3), 1, &x));
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(4), 1, &s));
+    for (int k = 5; k < 14; ++k)
+      if (k != 8) TF_RETURN_IF_ERROR(c->Merge(s, c->input(k), &s));
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(8), 2, &cdpp));
+    TF_RETURN_IF_ERROR(c->Concatenate(s, x, &h));
+    TF_RETURN_IF_ERROR(c->Merge(cdpp, h, &cdpp));
+    c->set_output(0, s);
+    return Status::OK();
+  });
+
+template <typename T>
+class DetectionProbabilityOp : public OpKernel {
+ public:
+  explicit DetectionProbabilityOp(OpKernelConstruction* context) : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    // Inputs
+    const Tensor& comp_norm_tensor = context->input(0);
+    const Tensor& mes0_tensor = context->input(1);
+    const Tensor& log_sig_mes_tensor = context->input(2);
+    const Tensor& x_tensor = context->input(3);
+    const Tensor& cdpp_tensor = context->input(8);
+
+    OP_REQUIRES(context, (comp_norm_tensor.NumElements() == 1), errors::InvalidArgument("'comp_norm' must be a scalar"));
+    OP_REQUIRES(context, (mes0_tensor.NumElements() == 3), errors::InvalidArgument("'mes0' must have 3 elements"));
+    OP_REQUIRES(context, (log_sig_mes_tensor.NumElements() == 3), errors::InvalidArgument("'log_sig_mes' must have 3 elements"));
+    OP_REQUIRES(context, (x_tensor.dims() == 1), errors::InvalidArgument("'durations' must be 1-dimensional"));
+
+    // Dimensions
+    const int64 N = x_tensor.dim_size(0);
+    const int64 M = context->input(4).NumElements();
+    OP_REQUIRES(context, (N >= 2), errors::InvalidArgument("'durations' must have at least 2 elements"));
+    for (int k = 4; k < 14; ++k)
+      if (k != 8) OP_REQUIRES(context, (context->input(k).NumElements() == M), errors::InvalidArgument("all inputs must have matching shapes"));
+    OP_REQUIRES(context, (cdpp_tensor.dims() == 2 && cdpp_tensor.dim_size(0) == M && cdpp_tensor.dim_size(1) == N),
+                errors::InvalidArgument("'cdpp' must have shape (M, N)"));
+
+    // Access the data
+    const auto x = x_tensor.template flat<T>();
+    for (int64 n = 0; n < N - 1; ++n)
+      OP_REQUIRES(context, (x(n+1) > x(n)), errors::InvalidArgument("'durations' must be sorted"));
+
+    batman::DetectionModel<T> model;
+    model.comp_norm = comp_norm_tensor.template flat<T>()(0);
+    for (int k = 0; k < 3; ++k) {
+      model.mes0[k] = mes0_tensor.template flat<T>()(k);
+      model.log_sig_mes[k] = log_sig_mes_tensor.template flat<T>()(k);
+    }
+    const T* cdpp = cdpp_tensor.template flat<T>().data();
+    const T *r_star = context->input(4).template flat<T>().data(),
+            *logg_star = context->input(5).template flat<T>().data(),
+            *g1 = context->input(6).template flat<T>().data(),
+            *g2 = context->input(7).template flat<T>().data(),
+            *dataspan = context->input(9).template flat<T>().data(),
+            *dutycycle = context->input(10).template flat<T>().data(),
+            *r_pl = context->input(11).template flat<T>().data(),
+            *period = context->input(12).template flat<T>().data(),
+            *b = context->input(13).template flat<T>().data();
+
+    // Output
+    Tensor* pdet_tensor = NULL;
+    OP_REQUIRES_OK(context, context->allocate_output(0, context->input(4).shape(), &pdet_tensor));
+    auto pdet = pdet_tensor->template flat<T>();
+
+    const batman::InterpSearch<T> search(batman::INTERP_SEARCH_AUTO, N, x.data());
+    auto work = [&](int64 begin, int64 end) {
+      batman::InterpSearch<T> shard_search(search);
+      for (int64 m = begin; m < end; ++m) {
+        const batman::DetectionSample<T> sample = {
+          r_star[m], logg_star[m], g1[m], g2[m], dataspan[m], dutycycle[m],
+          r_pl[m], period[m], b[m], cdpp + m * N
+        };
+        pdet(m) = batman::detection_probability<T>(model, shard_search, N, x.data(), sample);
+      }
+    };
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+    Shard(worker_threads.num_threads, worker_threads.workers, M,
+          kDetectionCostPerElement, work);
+  }
+};
+
+
+#define REGISTER_KERNEL(type)                                                 \
+  REGISTER_KERNEL_BUILDER(                                                    \
+      Name("DetectionProbability").Device(DEVICE_CPU).TypeConstraint<type>("T"), \
+      DetectionProbabilityOp<type>)
+
+REGISTER_KERNEL(float);
+REGISTER_KERNEL(double);
+
+#undef REGISTER_KERNEL
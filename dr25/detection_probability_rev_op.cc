@@ -0,0 +1,197 @@
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+#include <algorithm>
+
+#include "detection.h"
+#include "reduce.h"
+
+using namespace tensorflow;
+
+// Rough cost (in cycles) of one sample: batman::quad_grad plus the forward
+// pass through the durations and the logistic function and its adjoint
+static const int64 kDetectionRevCostPerElement = 2500;
+
+// The block size for the sums of the hyperparameter gradients over the
+// samples; see batman::blocked_sum
+static const int64 kDetectionRevBlockSize = 256;
+
+// comp_norm, mes0 and log_sig_mes
+static const int kDetectionNumHyper = 7;
+
+REGISTER_OP("DetectionProbabilityRev")
+  .Attr("T: {float, double}")
+  .Input("comp_norm: T")
+  .Input("mes0: T")
+  .Input("log_sig_mes: T")
+  .Input("durations: T")
+  .Input("r_star: T")
+  .Input("logg_star: T")
+  .Input("g1: T")
+  .Input("g2: T")
+  .Input("cdpp: T")
+  .Input("dataspan: T")
+  .Input("dutycycle: T")
+  .Input("r_pl: T")
+  .Input("period: T")
+  .Input("b: T")
+  .Input("bpdet: T")
+  .Output("bcomp_norm: T")
+  .Output("bmes0: T")
+  .Output("blog_sig_mes: T")
+  .Output("br_star: T")
+  .Output("blogg_star: T")
+  .Output("bg1: T")
+  .Output("bg2: T")
+  .Output("bcdpp: T")
+  .Output("bdataspan: T")
+  .Output("bdutycycle: T")
+  .Output("br_pl: T")
+  .Output("bperiod: T")
+  .Output("bb: T")
+  .SetShapeFn([](shape_inference::InferenceContext* c) {
+    shape_inference::ShapeHandle s, h, x, cdpp;
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &h));
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &h));
+    TF_RETURN_IF_ERROR(c->Merge(h, c->input(2), &h));
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(3), 1, &x));
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(4), 1, &s));
+    for (int k = 5; k < 15; ++k)
+      if (k != 8) TF_RETURN_IF_ERROR(c->Merge(s, c->input(k), &s));
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(8), 2, &cdpp));
+    TF_RETURN_IF_ERROR(c->Concatenate(s, x, &h));
+    TF_RETURN_IF_ERROR(c->Merge(cdpp, h, &cdpp));
+    for (int k = 0; k < 3; ++k) c->set_output(k, c->input(k));
+    for (int k = 3; k < 13; ++k) c->set_output(k, s);
+    c->set_output(7, cdpp);
+    return Status::OK();
+  });
+
+template <typename T>
+class DetectionProbabilityRevOp : public OpKernel {
+ public:
+  explicit DetectionProbabilityRevOp(OpKernelConstruction* context) : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    // Inputs
+    const Tensor& comp_norm_tensor = context->input(0);
+    const Tensor& mes0_tensor = context->input(1);
+    const Tensor& log_sig_mes_tensor = context->input(2);
+    const Tensor& x_tensor = context->input(3);
+    const Tensor& cdpp_tensor = context->input(8);
+    const Tensor& bpdet_tensor = context->input(14);
+
+    OP_REQUIRES(context, (comp_norm_tensor.NumElements() == 1), errors::InvalidArgument("'comp_norm' must be a scalar"));
+    OP_REQUIRES(context, (mes0_tensor.NumElements() == 3), errors::InvalidArgument("'mes0' must have 3 elements"));
+    OP_REQUIRES(context, (log_sig_mes_tensor.NumElements() == 3), errors::InvalidArgument("'log_sig_mes' must have 3 elements"));
+    OP_REQUIRES(context, (x_tensor.dims() == 1), errors::InvalidArgument("'durations' must be 1-dimensional"));
+
+    // Dimensions
+    const int64 N = x_tensor.dim_size(0);
+    const int64 M = context->input(4).NumElements();
+    OP_REQUIRES(context, (N >= 2), errors::InvalidArgument("'durations' must have at least 2 elements"));
+    for (int k = 4; k < 15; ++k)
+      if (k != 8) OP_REQUIRES(context, (context->input(k).NumElements() == M), errors::InvalidArgument("all inputs must have matching shapes"));
+    OP_REQUIRES(context, (cdpp_tensor.dims() == 2 && cdpp_tensor.dim_size(0) == M && cdpp_tensor.dim_size(1) == N),
+                errors::InvalidArgument("'cdpp' must have shape (M, N)"));
+
+    // Access the data
+    const auto x = x_tensor.template flat<T>();
+    for (int64 n = 0; n < N - 1; ++n)
+      OP_REQUIRES(context, (x(n+1) > x(n)), errors::InvalidArgument("'durations' must be sorted"));
+
+    batman::DetectionModel<T> model;
+    model.comp_norm = comp_norm_tensor.template flat<T>()(0);
+    for (int k = 0; k < 3; ++k) {
+      model.mes0[k] = mes0_tensor.template flat<T>()(k);
+      model.log_sig_mes[k] = log_sig_mes_tensor.template flat<T>()(k);
+    }
+    const T* cdpp = cdpp_tensor.template flat<T>().data();
+    const T *r_star = context->input(4).template flat<T>().data(),
+            *logg_star = context->input(5).template flat<T>().data(),
+            *g1 = context->input(6).template flat<T>().data(),
+            *g2 = context->input(7).template flat<T>().data(),
+            *dataspan = context->input(9).template flat<T>().data(),
+            *dutycycle = context->input(10).template flat<T>().data(),
+            *r_pl = context->input(11).template flat<T>().data(),
+            *period = context->input(12).template flat<T>().data(),
+            *b = context->input(13).template flat<T>().data();
+    const auto bpdet = bpdet_tensor.template flat<T>();
+
+    // Outputs
+    T* out[13];
+    for (int k = 0; k < 13; ++k) {
+      Tensor* out_tensor = NULL;
+      const TensorShape& shape = (k < 3) ? context->input(k).shape()
+                               : (k == 7) ? cdpp_tensor.shape() : context->input(4).shape();
+      OP_REQUIRES_OK(context, context->allocate_output(k, shape, &out_tensor));
+      out[k] = out_tensor->template flat<T>().data();
+    }
+    T *br_star = out[3], *blogg_star = out[4], *bg1 = out[5], *bg2 = out[6], *bcdpp = out[7],
+      *bdataspan = out[8], *bdutycycle = out[9], *br_pl = out[10], *bperiod = out[11], *bb = out[12];
+
+    // The per-sample gradients, and the sums over the samples for the
+    // hyperparameters
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+    auto shard = [&](int64 units, int64 cost, const std::function<void(int64, int64)>& work) {
+      Shard(worker_threads.num_threads, worker_threads.workers, units, cost, work);
+    };
+    Tensor partial_tensor;
+    OP_REQUIRES_OK(context, context->allocate_temp(DataTypeToEnum<T>::value,
+                                                   TensorShape({kDetectionNumHyper, batman::blocked_sum_blocks(M, kDetectionRevBlockSize)}),
+                                                   &partial_tensor));
+    const batman::InterpSearch<T> search(batman::INTERP_SEARCH_AUTO, N, x.data());
+    auto block = [&](int64, int64 begin, int64 end, T* sum) {
+      batman::InterpSearch<T> block_search(search);
+      batman::DetectionGrad<T> grad;
+      for (int64 m = begin; m < end; ++m) {
+        const batman::DetectionSample<T> sample = {
+          r_star[m], logg_star[m], g1[m], g2[m], dataspan[m], dutycycle[m],
+          r_pl[m], period[m], b[m], cdpp + m * N
+        };
+        batman::detection_probability_grad<T>(model, block_search, N, x.data(), sample, grad);
+        const T bp = bpdet(m);
+        br_star[m] = bp * grad.r_star;
+        blogg_star[m] = bp * grad.logg_star;
+        bg1[m] = bp * grad.g1;
+        bg2[m] = bp * grad.g2;
+        bdataspan[m] = bp * grad.dataspan;
+        bdutycycle[m] = bp * grad.dutycycle;
+        br_pl[m] = bp * grad.r_pl;
+        bperiod[m] = bp * grad.period;
+        bb[m] = bp * grad.b;
+
+        T* row = bcdpp + m * N;
+        std::fill(row, row + N, T(0.0));
+        row[grad.cdpp_index] = bp * grad.cdpp_left;
+        row[grad.cdpp_index + 1] = bp * grad.cdpp_right;
+
+        sum[0] += bp * grad.model.comp_norm;
+        for (int q = 0; q < 3; ++q) {
+          sum[1 + q] += bp * grad.model.mes0[q];
+          sum[4 + q] += bp * grad.model.log_sig_mes[q];
+        }
+      }
+    };
+    // comp_norm, mes0 and log_sig_mes are outputs 0, 1 and 2
+    auto store = [&](int q, int64, T value) {
+      if (q == 0) out[0][0] = value;
+      else out[1 + (q - 1) / 3][(q - 1) % 3] = value;
+    };
+    batman::blocked_sum<kDetectionNumHyper>(1, M, kDetectionRevBlockSize, partial_tensor.template flat<T>().data(),
+                                            shard, kDetectionRevCostPerElement, block, store);
+  }
+};
+
+
+#define REGISTER_KERNEL(type)                                                 \
+  REGISTER_KERNEL_BUILDER(                                                    \
+      Name("DetectionProbabilityRev").Device(DEVICE_CPU).TypeConstraint<type>("T"), \
+      DetectionProbabilityRevOp<type>)
+
+REGISTER_KERNEL(float);
+REGISTER_KERNEL(double);
+
+#undef REGISTER_KERNEL
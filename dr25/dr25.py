@@ -2,7 +2,10 @@
 
 from __future__ import division, print_function
 
-__all__ = ["quad"]
+__all__ = ["quad", "quad_table", "quad_basis", "quad_combine", "interp",
+           "interp_grad_y", "interp_gather", "interp_index", "interp_apply",
+           "transit_light_curve", "kepler_separation",
+           "detection_probability", "expected_detections", "sobol_sample"]
 
 import os
 import sysconfig
@@ -20,10 +23,22 @@ else:
 ops = tf.load_op_library(libfile)
 
 
-def quad(g1, g2, p, z):
+def quad(g1, g2, p, z, fused_grad=False):
+    # With fused_grad the partial derivatives are computed alongside the flux
+    # and the backward pass is just a multiply and reduce.
+    if fused_grad:
+        return ops.quad_with_grad(g1, g2, p, z)[0]
     return ops.quad(g1, g2, p, z)
 
 
+def quad_table(g1, g2, p, z, p_min=0.005, p_max=0.3, n_p=128, n_z=256):
+    # Interpolated from a precomputed table of the basis functions; see
+    # quad_table.h for the accuracy. Outside of [p_min, p_max] this falls
+    # back to the exact model.
+    return ops.quad_table(g1, g2, p, z, p_min=p_min, p_max=p_max,
+                          n_p=n_p, n_z=n_z)
+
+
 @tf.RegisterGradient("Quad")
 def _quad_grad(op, *grads):
     g1, g2, p, z = op.inputs
@@ -31,12 +46,256 @@ def _quad_grad(op, *grads):
     return ops.quad_rev(g1, g2, p, z, bf)
 
 
-def interp(t, x, y):
-    return ops.interp(t, x, y)[0]
+# The table is only an approximation of the exact model so its gradient is
+# taken from the exact derivatives.
+@tf.RegisterGradient("QuadTable")
+def _quad_table_grad(op, *grads):
+    g1, g2, p, z = op.inputs
+    bf = grads[0]
+    return ops.quad_rev(g1, g2, p, z, bf)
+
+
+def _sum_to_rank(x, like):
+    # Sum x over the trailing axes that like does not have, e.g. the time
+    # axis of z that the parameters are broadcast over. The ranks are only
+    # compared at run time when either is unknown statically.
+    if x.shape.ndims is None or like.shape.ndims is None:
+        return tf.reduce_sum(x, axis=tf.range(tf.rank(like), tf.rank(x)))
+    if x.shape.ndims > like.shape.ndims:
+        return tf.reduce_sum(x, axis=list(range(like.shape.ndims,
+                                                x.shape.ndims)))
+    return x
+
+
+@tf.RegisterGradient("QuadWithGrad")
+def _quad_with_grad_grad(op, *grads):
+    g1, g2, p, z = op.inputs
+    bf = grads[0]
+    bg1, bg2, bp, bz = [bf * d for d in op.outputs[1:]]
+    return [_sum_to_rank(bg1, g1), _sum_to_rank(bg2, g2),
+            _sum_to_rank(bp, p), bz]
+
+
+def quad_basis(p, z):
+    # The geometric part of the model: (lambdae, lambdad, etad) with the shape
+    # of z. Pass these to quad_combine to get the flux for any number of limb
+    # darkening coefficients without recomputing the elliptic integrals.
+    return ops.quad_basis(p, z)
+
+
+@tf.RegisterGradient("QuadBasis")
+def _quad_basis_grad(op, *grads):
+    p, z = op.inputs
+    ble, bld, bed = [tf.zeros_like(x) if g is None else g
+                     for x, g in zip(op.outputs, grads)]
+    return ops.quad_basis_rev(p, z, ble, bld, bed)
+
+
+def quad_combine(g1, g2, lambdae, lambdad, etad, batch_dims=0):
+    # The flux for every (g1, g2) pair and every set of basis functions. The
+    # first batch_dims dimensions are shared, e.g. for (S, K) coefficients
+    # and an (S, M) basis, batch_dims=1 gives an (S, K, M) flux instead of
+    # the (S, K, S, M) outer product. In general the shape is
+    # g1.shape + lambdae.shape[batch_dims:].
+    return ops.quad_combine(g1, g2, lambdae, lambdad, etad,
+                            batch_dims=batch_dims)
+
+
+@tf.RegisterGradient("QuadCombine")
+def _quad_combine_grad(op, *grads):
+    g1, g2, lambdae, lambdad, etad = op.inputs
+    bf = grads[0]
+    return ops.quad_combine_rev(g1, g2, lambdae, lambdad, etad, bf,
+                                batch_dims=op.get_attr("batch_dims"))
+
+
+def interp(t, x, y, search="auto"):
+    # search is one of "auto", "binary", "scan", "walk", "uniform" or
+    # "log_uniform"; see interp.h. y is the (M, N) table flattened to
+    # (M*N,), which gets a sparse gradient. An (M, N) y (or one of unknown
+    # rank) is also accepted but has no gradient; dy needs the flattened
+    # table, or use interp_grad_y.
+    return ops.interp(t, x, y, search=search)[0]
 
 
 @tf.RegisterGradient("Interp")
 def _interp_grad(op, *grads):
+    t, x, y = op.inputs
+    dz = op.outputs[1]
+    bz = grads[0]
+
+    # The gradient with respect to y has two non-zeros per query and is
+    # returned as IndexedSlices of the flattened table, so the dense table of
+    # gradients is never formed. An (M, N) table (or one of unknown rank)
+    # would need a dense gradient, so none is returned for it.
+    if y.shape.ndims != 1:
+        return [bz * dz, None, None]
+    indices, values = ops.interp_grad_y(t, x, bz, search=op.get_attr("search"))
+    by = tf.IndexedSlices(tf.reshape(values, [-1]), tf.reshape(indices, [-1]),
+                          dense_shape=tf.shape(y, out_type=tf.int64))
+    return [bz * dz, None, by]
+
+
+def interp_grad_y(t, x, bz, search="auto"):
+    # The gradient of sum(bz * interp(t, x, y)) with respect to the (M, N)
+    # table y as a tf.SparseTensor with two entries per row
+    indices, values = ops.interp_grad_y(t, x, bz, search=search)
+    n = tf.shape(x, out_type=tf.int64)[0]
+    indices = tf.reshape(indices, [-1])
+    return tf.SparseTensor(
+        indices=tf.stack([indices // n, indices % n], axis=1),
+        values=tf.reshape(values, [-1]),
+        dense_shape=tf.stack([tf.shape(t, out_type=tf.int64)[0], n]))
+
+
+def interp_gather(t, x, y, rows, search="auto"):
+    # Like interp(t, x, tf.gather(y, rows)) for an (S, N) table y without
+    # forming the gathered (M, N) table
+    return ops.interp_gather(t, x, y, rows, search=search)[0]
+
+
+@tf.RegisterGradient("InterpGather")
+def _interp_gather_grad(op, *grads):
+    t, x, y, rows = op.inputs
     dz = op.outputs[1]
     bz = grads[0]
-    return [bz * dz, None, None]
+    by = ops.interp_gather_rev(t, x, y, rows, bz, search=op.get_attr("search"))
+    return [bz * dz, None, by, None]
+
+
+def interp_index(t, x, search="auto"):
+    # The bins of t in the grid x as (index, weight); the search only needs
+    # to run once for any number of tables passed to interp_apply
+    index, weight, _ = ops.interp_index(t, x, search=search)
+    return index, weight
+
+
+@tf.RegisterGradient("InterpIndex")
+def _interp_index_grad(op, *grads):
+    dweight = op.outputs[2]
+    bw = grads[1]
+    if bw is None:
+        return [None, None]
+    return [bw * dweight, None]
+
+
+def interp_apply(index, weight, y):
+    # As for interp, y is the (M, N) table or the same table flattened to
+    # (M*N,), and only the flattened table gets a (sparse) gradient; an
+    # (M, N) y has none
+    return ops.interp_apply(index, weight, y)
+
+
+@tf.RegisterGradient("InterpApply")
+def _interp_apply_grad(op, *grads):
+    index, weight, y = op.inputs
+    bz = grads[0]
+    bweight = ops.interp_apply_rev(index, weight, y, bz)
+    if y.shape.ndims != 1:
+        return [None, bweight, None]
+    indices, values = ops.interp_apply_grad_y(index, weight, y, bz)
+    by = tf.IndexedSlices(tf.reshape(values, [-1]), tf.reshape(indices, [-1]),
+                          dense_shape=tf.shape(y, out_type=tf.int64))
+    return [None, bweight, by]
+
+
+def transit_light_curve(g1, g2, p, t0, period, a, b, t, texp=0.0,
+                        oversample=1):
+    # The flux of a planet on a circular orbit at the times t, which have the
+    # shape of the parameters or that shape plus one more axis. Each cadence
+    # is averaged over oversample points spanning the exposure time texp. a
+    # and b are in units of the stellar radius; see transit.h.
+    return ops.transit_light_curve(g1, g2, p, t0, period, a, b, t, texp=texp,
+                                   oversample=oversample)
+
+
+@tf.RegisterGradient("TransitLightCurve")
+def _transit_light_curve_grad(op, *grads):
+    bf = grads[0]
+    return ops.transit_light_curve_rev(
+        *(list(op.inputs) + [bf]), texp=op.get_attr("texp"),
+        oversample=op.get_attr("oversample"))
+
+
+def kepler_separation(t0, period, e, omega, a, incl, t):
+    # The sky separation in stellar radii of a planet on an eccentric orbit
+    # at the times t, which have the shape of the parameters or that shape
+    # plus one more axis. t0 is a time of mid-transit and omega and incl are
+    # in radians. The separation is +inf while the planet is behind the
+    # star, which quad treats as out of transit; see kepler.h.
+    return ops.kepler_separation(t0, period, e, omega, a, incl, t)[0]
+
+
+@tf.RegisterGradient("KeplerSeparation")
+def _kepler_separation_grad(op, *grads):
+    bz = grads[0]
+    dt0 = op.outputs[1]
+    bparams = [_sum_to_rank(bz * d, x)
+               for d, x in zip(op.outputs[1:], op.inputs[:6])]
+    return bparams + [-bz * dt0]
+
+
+def detection_probability(comp_norm, mes0, log_sig_mes, durations, r_star,
+                          logg_star, g1, g2, cdpp, dataspan, dutycycle, r_pl,
+                          period, b):
+    # The clipped completeness pdet of the model in simple.ipynb for each
+    # simulated planet, from the transit durations through the depth, the
+    # CDPP interpolated at the full duration and the MES, all in one pass;
+    # see detection.h. comp_norm is a scalar, mes0 and log_sig_mes are the
+    # 3 coefficients of the quadratics in the transit shape, cdpp has shape
+    # (M, len(durations)) and the rest are (M,).
+    return ops.detection_probability(comp_norm, mes0, log_sig_mes, durations,
+                                     r_star, logg_star, g1, g2, cdpp,
+                                     dataspan, dutycycle, r_pl, period, b)
+
+
+@tf.RegisterGradient("DetectionProbability")
+def _detection_probability_grad(op, *grads):
+    bpdet = grads[0]
+    bs = ops.detection_probability_rev(*(list(op.inputs) + [bpdet]))
+    return list(bs[:3]) + [None] + list(bs[3:])
+
+
+def expected_detections(comp_norm, mes0, log_sig_mes, rate, durations, r_star,
+                        logg_star, g1, g2, cdpp, dataspan, dutycycle,
+                        min_period, max_period, min_radius, max_radius,
+                        num_samples=1000000, seed=42, quasi=False,
+                        efficiency=1.0):
+    # The expected number of detections: the integral of the occurrence rate
+    # exp(rate[0] + rate[1] * ln P + rate[2] * ln R) times the total
+    # detection probability over ln P, ln R and b, summed over the S stars.
+    # As in simple.ipynb the total detection probability includes the
+    # constant vetting efficiency, so pass robo["eff"] as efficiency.
+    # It is estimated from num_samples Monte Carlo samples that are drawn
+    # and reduced in blocks without being stored, so num_samples can be
+    # much larger than memory; see expected.h. With quasi=True the samples
+    # are scrambled Sobol points instead, which reach the same error with
+    # far fewer samples (use a power of 2). cdpp has shape
+    # (S, len(durations)) and the other stellar inputs are (S,).
+    value = ops.expected_detections(comp_norm, mes0, log_sig_mes, rate,
+                                    durations, r_star, logg_star, g1, g2,
+                                    cdpp, dataspan, dutycycle,
+                                    num_samples=num_samples, seed=seed,
+                                    quasi=quasi,
+                                    min_period=min_period,
+                                    max_period=max_period,
+                                    min_radius=min_radius,
+                                    max_radius=max_radius,
+                                    efficiency=efficiency)
+    return value[0]
+
+
+@tf.RegisterGradient("ExpectedDetections")
+def _expected_detections_grad(op, *grads):
+    bvalue = grads[0]
+    return ([bvalue * d for d in op.outputs[1:]] +
+            [None for _ in op.inputs[4:]])
+
+
+def sobol_sample(num_samples, dims, offset=0, seed=42, dtype=tf.float64):
+    # The points offset, ..., offset + num_samples - 1 of an Owen-scrambled
+    # Sobol sequence in dims <= 16 dimensions as a (num_samples, dims) tensor
+    # in [0, 1); see sobol.h. The same seed always gives the same sequence
+    # so consecutive slices can be generated separately.
+    return ops.sobol_sample(num_samples=num_samples, dims=dims, offset=offset,
+                            seed=seed, T=dtype)
@@ -2,65 +2,152 @@
 #define _DR25_ELLINT_H_
 
 #include <cmath>
+#include "precision.h"
 
 namespace batman {
 
   using std::abs;
-
-#define ELLINT_CONV_TOL 1.0e-8
-#define ELLINT_MAX_ITER 200
+  using std::sqrt;
 
   // K: 1.0 - k^2 >= 0.0
   template <typename T>
   T ellint_1 (const T& k) {
-    T kc = sqrt(1.0 - k * k), m = T(1.0), h;
-    for (int i = 0; i < ELLINT_MAX_ITER; ++i) {
+    typedef typename scalar_type<T>::type S;
+    const S tol = S(ellint_precision<S>::tol);
+    const int max_iter = ellint_precision<S>::max_iter;
+    T kc = sqrt(S(1.0) - k * k), m = T(1.0), h;
+    for (int i = 0; i < max_iter; ++i) {
       h = m;
       m += kc;
-      if (abs(h - kc) / h <= ELLINT_CONV_TOL) break;
+      if (abs(h - kc) / h <= tol) break;
       kc = sqrt(h * kc);
-      m *= 0.5;
+      m *= S(0.5);
     }
-    return M_PI / m;
+    return S(M_PI) / m;
   }
 
   // E: 1.0 - k^2 >= 0.0
   template <typename T>
   T ellint_2 (const T& k) {
-    T b = 1.0 - k * k, kc = sqrt(b), m = T(1.0), c = T(1.0), a = b + 1.0, m0;
-    for (int i = 0; i < ELLINT_MAX_ITER; ++i) {
-      b = 2.0 * (c * kc + b);
+    typedef typename scalar_type<T>::type S;
+    const S tol = S(ellint_precision<S>::tol);
+    const int max_iter = ellint_precision<S>::max_iter;
+    T b = S(1.0) - k * k, kc = sqrt(b), m = T(1.0), c = T(1.0), a = b + S(1.0), m0;
+    for (int i = 0; i < max_iter; ++i) {
+      b = S(2.0) * (c * kc + b);
       c = a;
       m0 = m;
       m += kc;
       a += b / m;
-      if (abs(m0 - kc) / m0 <= ELLINT_CONV_TOL) break;
-      kc = 2.0 * sqrt(kc * m0);
+      if (abs(m0 - kc) / m0 <= tol) break;
+      kc = S(2.0) * sqrt(kc * m0);
     }
-    return M_PI_4 * a / m;
+    return S(M_PI_4) * a / m;
   }
 
   // Pi: 1.0 - k^2 >= 0.0 & 0.0 <= n < 1.0 (doesn't seem consistent for n < 0.0)
   template <typename T>
   T ellint_3 (const T& n, const T& k) {
-    T kc = sqrt(1.0 - k * k), p = sqrt(1.0 - n), m0 = 1.0, c = 1.0, d = 1.0 / p, e = kc, f, g;
-    for (int i = 0; i < ELLINT_MAX_ITER; ++i) {
+    typedef typename scalar_type<T>::type S;
+    const S tol = S(ellint_precision<S>::tol);
+    const int max_iter = ellint_precision<S>::max_iter;
+    T kc = sqrt(S(1.0) - k * k), p = sqrt(S(1.0) - n), m0 = S(1.0), c = S(1.0), d = S(1.0) / p, e = kc, f, g;
+    for (int i = 0; i < max_iter; ++i) {
       f = c;
       c += d / p;
       g = e / p;
-      d = 2.0 * (f * g + d);
+      d = S(2.0) * (f * g + d);
       p = g + p;
       g = m0;
       m0 = kc + m0;
-      if (abs(1.0 - kc / g) <= ELLINT_CONV_TOL) break;
-      kc = 2.0 * sqrt(e);
+      if (abs(S(1.0) - kc / g) <= tol) break;
+      kc = S(2.0) * sqrt(e);
       e = kc * m0;
     }
-    return M_PI_2 * (c * m0 + d) / (m0 * (m0 + p));
+    return S(M_PI_2) * (c * m0 + d) / (m0 * (m0 + p));
+  }
+
+  // K(k), E(k) and Pi(n, k) from a single shared iteration. All three are
+  // special cases of Bulirsch's general complete integral cel(kc, p, a, b):
+  // K = cel(kc, 1, 1, 1), E = cel(kc, 1, 1, kc^2) and Pi = cel(kc, 1-n, 1, 1).
+  // The sequence of kc and m0 doesn't depend on (p, a, b) and K and E also
+  // share p, so one loop carries all of them. This is a class so that other
+  // scalar types (see ellint_grad.h) can provide a specialization that is
+  // found when quad is instantiated.
+  template <typename T>
+  struct ellint_fused {
+    template <bool with_pi>
+    static void run (const T& n, const T& k, T& Kk, T& Ek, T& Pk) {
+      typedef typename scalar_type<T>::type S;
+      const S tol = S(ellint_precision<S>::tol);
+      const int max_iter = ellint_precision<S>::max_iter;
+      T kc = sqrt(S(1.0) - k * k), e = kc, m0 = T(1.0), g, f,
+        p = T(1.0), aK = T(1.0), bK = T(1.0), aE = T(1.0), bE = S(1.0) - k * k,
+        pP = T(1.0), aP = T(1.0), bP = T(1.0);
+      if (with_pi) {
+        pP = sqrt(S(1.0) - n);
+        bP = S(1.0) / pP;
+      }
+      for (int i = 0; i < max_iter; ++i) {
+        g = e / p;
+        f = aK;
+        aK += bK / p;
+        bK = S(2.0) * (f * g + bK);
+        f = aE;
+        aE += bE / p;
+        bE = S(2.0) * (f * g + bE);
+        p = g + p;
+        if (with_pi) {
+          g = e / pP;
+          f = aP;
+          aP += bP / pP;
+          bP = S(2.0) * (f * g + bP);
+          pP = g + pP;
+        }
+        g = m0;
+        m0 = kc + m0;
+        if (abs(S(1.0) - kc / g) <= tol) break;
+        kc = S(2.0) * sqrt(e);
+        e = kc * m0;
+      }
+      Kk = S(M_PI_2) * (aK * m0 + bK) / (m0 * (m0 + p));
+      Ek = S(M_PI_2) * (aE * m0 + bE) / (m0 * (m0 + p));
+      if (with_pi) Pk = S(M_PI_2) * (aP * m0 + bP) / (m0 * (m0 + pP));
+    }
+
+    static void ke (const T& k, T& Kk, T& Ek) {
+      T Pk;
+      run<false>(T(0.0), k, Kk, Ek, Pk);
+    }
+
+    static void kep (const T& n, const T& k, T& Kk, T& Ek, T& Pk) {
+      run<true>(n, k, Kk, Ek, Pk);
+    }
+  };
+
+  // K and E: 1.0 - k^2 >= 0.0
+  template <typename T>
+  void ellint_12 (const T& k, T& Kk, T& Ek) {
+    ellint_fused<T>::ke(k, Kk, Ek);
+  }
+
+  // K, E and Pi: 1.0 - k^2 >= 0.0 & n < 1.0
+  template <typename T>
+  void ellint_123 (const T& n, const T& k, T& Kk, T& Ek, T& Pk) {
+    ellint_fused<T>::kep(n, k, Kk, Ek, Pk);
   }
 
-#undef ELLINT_CONV_TOL
-#undef ELLINT_MAX_ITER
+  // The partial derivatives of K(k), E(k) and Pi(n, k) given their values
+  template <typename T>
+  void ellint_123_grad (const T& n, const T& k, const T& Kk, const T& Ek, const T& Pk,
+                        T& dK_dk, T& dE_dk, T& dP_dn, T& dP_dk) {
+    typedef typename scalar_type<T>::type S;
+    T k2 = k * k, n2 = n * n;
+    dK_dk = (Ek / (S(1.0) - k2) - Kk) / k;
+    dE_dk = (Ek - Kk) / k;
+    dP_dn = S(0.5)*(Ek + (Kk*(k2-n) + Pk*(n2-k2))/n) / (n-S(1.0)) / (k2-n);
+    dP_dk = -k * (Ek / (k2 - S(1.0)) + Pk) / (k2-n);
+  }
 
 }
 
@@ -0,0 +1,231 @@
+#ifndef _DR25_ELLINT_BATCH_H_
+#define _DR25_ELLINT_BATCH_H_
+
+#include <cmath>
+#include <algorithm>
+#include "simd.h"
+#include "precision.h"
+
+namespace batman {
+
+  // Batch versions of ellint_1, ellint_2, ellint_3 and of the fused
+  // ellint_12 and ellint_123. These run the same iterations as the scalar
+  // versions across all of the lanes of a packet at once; lanes that have
+  // converged are masked out of the updates and the loop exits when no lane
+  // is left active. For double precision the results are identical to the
+  // scalar functions.
+
+  namespace detail {
+
+    // Apply a packet kernel to n elements, padding the final partial packet
+    // with the value pad.
+    template <typename T, typename Kernel>
+    void ellint_apply (int n, const T* x, T* out, const T& pad, Kernel kernel) {
+      typedef simd::packet<T> P;
+      int i = 0;
+      for (; i + P::size <= n; i += P::size)
+        P::store(out + i, kernel(P::load(x + i)));
+      if (i < n) {
+        T buf[P::size];
+        std::fill(buf, buf + P::size, pad);
+        std::copy(x + i, x + n, buf);
+        P::store(buf, kernel(P::load(buf)));
+        std::copy(buf, buf + (n - i), out + i);
+      }
+    }
+
+    template <typename T, typename Kernel>
+    void ellint_apply (int n, const T* x, const T* y, T* out, const T& pad, Kernel kernel) {
+      typedef simd::packet<T> P;
+      int i = 0;
+      for (; i + P::size <= n; i += P::size)
+        P::store(out + i, kernel(P::load(x + i), P::load(y + i)));
+      if (i < n) {
+        T bx[P::size], by[P::size];
+        std::fill(bx, bx + P::size, pad);
+        std::fill(by, by + P::size, pad);
+        std::copy(x + i, x + n, bx);
+        std::copy(y + i, y + n, by);
+        P::store(bx, kernel(P::load(bx), P::load(by)));
+        std::copy(bx, bx + (n - i), out + i);
+      }
+    }
+
+    template <typename T>
+    typename simd::packet<T>::type ellint_1_packet (const typename simd::packet<T>::type& k) {
+      typedef simd::packet<T> P;
+      typedef typename P::type V;
+      typedef typename P::mask Mask;
+      const V one = P::set1(T(1.0)), half = P::set1(T(0.5)), tol = P::set1(T(ellint_precision<T>::tol));
+      V kc = P::sqrt(P::sub(one, P::mul(k, k))), m = one, h;
+      Mask active = P::all_true();
+      for (int i = 0; i < ellint_precision<T>::max_iter; ++i) {
+        h = m;
+        m = P::select(active, P::add(m, kc), m);
+        active = P::mask_andnot(active, P::le(P::div(P::abs(P::sub(h, kc)), h), tol));
+        if (!P::any(active)) break;
+        kc = P::select(active, P::sqrt(P::mul(h, kc)), kc);
+        m = P::select(active, P::mul(m, half), m);
+      }
+      return P::div(P::set1(T(M_PI)), m);
+    }
+
+    template <typename T>
+    typename simd::packet<T>::type ellint_2_packet (const typename simd::packet<T>::type& k) {
+      typedef simd::packet<T> P;
+      typedef typename P::type V;
+      typedef typename P::mask Mask;
+      const V one = P::set1(T(1.0)), two = P::set1(T(2.0)), tol = P::set1(T(ellint_precision<T>::tol));
+      V b = P::sub(one, P::mul(k, k)), kc = P::sqrt(b), m = one, c = one, a = P::add(b, one), m0;
+      Mask active = P::all_true();
+      for (int i = 0; i < ellint_precision<T>::max_iter; ++i) {
+        b = P::select(active, P::mul(two, P::add(P::mul(c, kc), b)), b);
+        c = P::select(active, a, c);
+        m0 = m;
+        m = P::select(active, P::add(m, kc), m);
+        a = P::select(active, P::add(a, P::div(b, m)), a);
+        active = P::mask_andnot(active, P::le(P::div(P::abs(P::sub(m0, kc)), m0), tol));
+        if (!P::any(active)) break;
+        kc = P::select(active, P::mul(two, P::sqrt(P::mul(kc, m0))), kc);
+      }
+      return P::div(P::mul(P::set1(T(M_PI_4)), a), m);
+    }
+
+    template <typename T>
+    typename simd::packet<T>::type ellint_3_packet (const typename simd::packet<T>::type& n,
+                                                    const typename simd::packet<T>::type& k) {
+      typedef simd::packet<T> P;
+      typedef typename P::type V;
+      typedef typename P::mask Mask;
+      const V one = P::set1(T(1.0)), two = P::set1(T(2.0)), tol = P::set1(T(ellint_precision<T>::tol));
+      V kc = P::sqrt(P::sub(one, P::mul(k, k))), p = P::sqrt(P::sub(one, n)), m0 = one, c = one,
+        d = P::div(one, p), e = kc, f, g;
+      Mask active = P::all_true();
+      for (int i = 0; i < ellint_precision<T>::max_iter; ++i) {
+        f = c;
+        c = P::select(active, P::add(c, P::div(d, p)), c);
+        g = P::div(e, p);
+        d = P::select(active, P::mul(two, P::add(P::mul(f, g), d)), d);
+        p = P::select(active, P::add(g, p), p);
+        g = m0;
+        m0 = P::select(active, P::add(kc, m0), m0);
+        active = P::mask_andnot(active, P::le(P::abs(P::sub(one, P::div(kc, g))), tol));
+        if (!P::any(active)) break;
+        kc = P::select(active, P::mul(two, P::sqrt(e)), kc);
+        e = P::select(active, P::mul(kc, m0), e);
+      }
+      return P::div(P::mul(P::set1(T(M_PI_2)), P::add(P::mul(c, m0), d)),
+                    P::mul(m0, P::add(m0, p)));
+    }
+
+    // The fused K, E and (optionally) Pi iteration from ellint_fused
+    template <typename T, bool with_pi>
+    void ellint_fused_packet (const typename simd::packet<T>::type& n,
+                              const typename simd::packet<T>::type& k,
+                              typename simd::packet<T>::type& Kk,
+                              typename simd::packet<T>::type& Ek,
+                              typename simd::packet<T>::type& Pk) {
+      typedef simd::packet<T> P;
+      typedef typename P::type V;
+      typedef typename P::mask Mask;
+      const V one = P::set1(T(1.0)), two = P::set1(T(2.0)), tol = P::set1(T(ellint_precision<T>::tol));
+      V kc2 = P::sub(one, P::mul(k, k)), kc = P::sqrt(kc2), e = kc, m0 = one, g, f,
+        p = one, aK = one, bK = one, aE = one, bE = kc2, pP = one, aP = one, bP = one;
+      if (with_pi) {
+        pP = P::sqrt(P::sub(one, n));
+        bP = P::div(one, pP);
+      }
+      Mask active = P::all_true();
+      for (int i = 0; i < ellint_precision<T>::max_iter; ++i) {
+        g = P::div(e, p);
+        f = aK;
+        aK = P::select(active, P::add(aK, P::div(bK, p)), aK);
+        bK = P::select(active, P::mul(two, P::add(P::mul(f, g), bK)), bK);
+        f = aE;
+        aE = P::select(active, P::add(aE, P::div(bE, p)), aE);
+        bE = P::select(active, P::mul(two, P::add(P::mul(f, g), bE)), bE);
+        p = P::select(active, P::add(g, p), p);
+        if (with_pi) {
+          g = P::div(e, pP);
+          f = aP;
+          aP = P::select(active, P::add(aP, P::div(bP, pP)), aP);
+          bP = P::select(active, P::mul(two, P::add(P::mul(f, g), bP)), bP);
+          pP = P::select(active, P::add(g, pP), pP);
+        }
+        g = m0;
+        m0 = P::select(active, P::add(kc, m0), m0);
+        active = P::mask_andnot(active, P::le(P::abs(P::sub(one, P::div(kc, g))), tol));
+        if (!P::any(active)) break;
+        kc = P::select(active, P::mul(two, P::sqrt(e)), kc);
+        e = P::select(active, P::mul(kc, m0), e);
+      }
+      const V pi_2 = P::set1(T(M_PI_2));
+      Kk = P::div(P::mul(pi_2, P::add(P::mul(aK, m0), bK)), P::mul(m0, P::add(m0, p)));
+      Ek = P::div(P::mul(pi_2, P::add(P::mul(aE, m0), bE)), P::mul(m0, P::add(m0, p)));
+      if (with_pi)
+        Pk = P::div(P::mul(pi_2, P::add(P::mul(aP, m0), bP)), P::mul(m0, P::add(m0, pP)));
+    }
+
+    template <typename T, bool with_pi>
+    void ellint_fused_apply (int num, const T* n, const T* k, T* Kk, T* Ek, T* Pk) {
+      typedef simd::packet<T> P;
+      typedef typename P::type V;
+      V zero = P::set1(T(0.0)), K = zero, E = zero, Pi = zero;
+      int i = 0;
+      for (; i + P::size <= num; i += P::size) {
+        ellint_fused_packet<T, with_pi>(with_pi ? P::load(n + i) : zero, P::load(k + i), K, E, Pi);
+        P::store(Kk + i, K);
+        P::store(Ek + i, E);
+        if (with_pi) P::store(Pk + i, Pi);
+      }
+      if (i < num) {
+        T bn[P::size], bk[P::size], bK[P::size], bE[P::size], bP[P::size];
+        std::fill(bn, bn + P::size, T(0.0));
+        std::fill(bk, bk + P::size, T(0.0));
+        if (with_pi) std::copy(n + i, n + num, bn);
+        std::copy(k + i, k + num, bk);
+        ellint_fused_packet<T, with_pi>(P::load(bn), P::load(bk), K, E, Pi);
+        P::store(bK, K);
+        P::store(bE, E);
+        P::store(bP, Pi);
+        std::copy(bK, bK + (num - i), Kk + i);
+        std::copy(bE, bE + (num - i), Ek + i);
+        if (with_pi) std::copy(bP, bP + (num - i), Pk + i);
+      }
+    }
+
+  }
+
+  // K and E for num values of k
+  template <typename T>
+  void ellint_12_batch (int num, const T* k, T* Kk, T* Ek) {
+    detail::ellint_fused_apply<T, false>(num, NULL, k, Kk, Ek, NULL);
+  }
+
+  // K, E and Pi for num values of (n, k)
+  template <typename T>
+  void ellint_123_batch (int num, const T* n, const T* k, T* Kk, T* Ek, T* Pk) {
+    detail::ellint_fused_apply<T, true>(num, n, k, Kk, Ek, Pk);
+  }
+
+  // K for n values of k
+  template <typename T>
+  void ellint_1_batch (int n, const T* k, T* K) {
+    detail::ellint_apply(n, k, K, T(0.0), detail::ellint_1_packet<T>);
+  }
+
+  // E for n values of k
+  template <typename T>
+  void ellint_2_batch (int n, const T* k, T* E) {
+    detail::ellint_apply(n, k, E, T(0.0), detail::ellint_2_packet<T>);
+  }
+
+  // Pi for n values of (nu, k)
+  template <typename T>
+  void ellint_3_batch (int n, const T* nu, const T* k, T* Pi) {
+    detail::ellint_apply(n, nu, k, Pi, T(0.0), detail::ellint_3_packet<T>);
+  }
+
+}
+
+#endif
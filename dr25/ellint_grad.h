@@ -4,54 +4,41 @@
 #include <cmath>
 #include <Eigen/Core>
 #include <AutoDiffScalar.h>
+#include "precision.h"
 
 namespace batman {
 
   using std::abs;
 
-  // Gradients.
-  template <typename T>
-  Eigen::AutoDiffScalar<T> ellint_1 (const Eigen::AutoDiffScalar<T>& z)
-  {
-    typename T::Scalar value = z.value(),
-              Kz = ellint_1(value),
-              Ez = ellint_2(value),
-              z2 = value * value;
-    return Eigen::AutoDiffScalar<T>(
-      Kz,
-      z.derivatives() * (Ez / (1.0 - z2) - Kz) / value
-    );
-  }
-
-  template <typename T>
-  Eigen::AutoDiffScalar<T> ellint_2 (const Eigen::AutoDiffScalar<T>& z)
-  {
-    typename T::Scalar value = z.value(),
-              Kz = ellint_1(value),
-              Ez = ellint_2(value);
-    return Eigen::AutoDiffScalar<T>(
-      Ez,
-      z.derivatives() * (Ez - Kz) / value
-    );
-  }
-
-  template <typename T>
-  Eigen::AutoDiffScalar<T> ellint_3 (const Eigen::AutoDiffScalar<T>& n,
-                                     const Eigen::AutoDiffScalar<T>& k)
-  {
-    typename T::Scalar k_value = k.value(),
-                       n_value = n.value(),
-                       Kk = ellint_1(k_value),
-                       Ek = ellint_2(k_value),
-                       Pnk = ellint_3(n_value, k_value),
-                       k2 = k_value * k_value,
-                       n2 = n_value * n_value;
-    return Eigen::AutoDiffScalar<T>(
-      Pnk,
-      (n.derivatives() * 0.5*(Ek + (Kk*(k2-n_value) + Pnk*(n2-k2))/n_value) / (n_value-1.0) -
-      k.derivatives() * k_value * (Ek / (k2 - 1.0) + Pnk)) / (k2-n_value)
-    );
-  }
+  // Constants in the templated code are plain scalars for AutoDiff types
+  template <typename D>
+  struct scalar_type<Eigen::AutoDiffScalar<D> > {
+    typedef typename Eigen::AutoDiffScalar<D>::Scalar type;
+  };
+
+  // The fused integrals call the scalar version once and then propagate the
+  // derivatives analytically.
+  template <typename D>
+  struct ellint_fused<Eigen::AutoDiffScalar<D> > {
+    typedef Eigen::AutoDiffScalar<D> T;
+    typedef typename D::Scalar Scalar;
+
+    static void ke (const T& k, T& Kk, T& Ek) {
+      Scalar value = k.value(), K, E;
+      ellint_12(value, K, E);
+      Kk = T(K, k.derivatives() * ((E / (1.0 - value * value) - K) / value));
+      Ek = T(E, k.derivatives() * ((E - K) / value));
+    }
+
+    static void kep (const T& n, const T& k, T& Kk, T& Ek, T& Pk) {
+      Scalar K, E, P, dK_dk, dE_dk, dP_dn, dP_dk;
+      ellint_123(n.value(), k.value(), K, E, P);
+      ellint_123_grad(n.value(), k.value(), K, E, P, dK_dk, dE_dk, dP_dn, dP_dk);
+      Kk = T(K, k.derivatives() * dK_dk);
+      Ek = T(E, k.derivatives() * dE_dk);
+      Pk = T(P, n.derivatives() * dP_dn + k.derivatives() * dP_dk);
+    }
+  };
 
 }
 
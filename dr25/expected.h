@@ -0,0 +1,157 @@
+#ifndef _DR25_EXPECTED_H_
+#define _DR25_EXPECTED_H_
+
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include "detection.h"
+#include "sobol.h"
+
+namespace batman {
+
+  // A streaming Monte Carlo estimate of the expected number of detections
+  //
+  //   N_exp = sum over stars of the integral of rate(P, R) * pdet_tot(P, R, b)
+  //
+  // over ln P, ln R and b in [0, 1) for a population with
+  //
+  //   rate(P, R) = exp(ln_rate + alpha_period * ln P + alpha_radius * ln R)
+  //
+  // planets per star per unit ln P and ln R. pdet_tot = eff * pdet, where
+  // pdet is the completeness of detection.h times the window function and
+  // the geometric transit probability and eff is the constant vetting
+  // efficiency (robo["eff"]), as in simple.ipynb. Each sample draws a star
+  // uniformly and (ln P, ln R, b) uniformly in the box, so
+  //
+  //   N_exp ~= eff * S * V * mean(rate * pdet)
+  //
+  // with S stars and the box volume V. The sums below leave out eff, which
+  // is applied with the normalization in expected_norm. The samples are
+  // generated from their index, either pseudo-random (ExpectedRandom) or
+  // quasi-random (ExpectedSobol), and never stored, so the memory doesn't
+  // grow with the number of samples and any block of samples can be
+  // evaluated on any thread.
+
+  // The parameters of the planet population
+  template <typename T>
+  struct ExpectedRate {
+    T ln_rate, alpha_period, alpha_radius;
+  };
+
+  // The region that is integrated over, with the periods in days and the
+  // radii in Earth radii
+  template <typename T>
+  struct ExpectedBox {
+    T min_period, max_period, min_radius, max_radius;
+  };
+
+  // The stars that the samples are drawn from; cdpp is (S, N)
+  template <typename T>
+  struct ExpectedStars {
+    std::int64_t S;
+    const T *r_star, *logg_star, *g1, *g2, *cdpp, *dataspan, *dutycycle;
+  };
+
+  // The running sums over samples: rate * pdet (which is also its
+  // derivative with respect to ln_rate), its derivatives with respect to
+  // comp_norm, mes0 and log_sig_mes, and its products with ln P and ln R
+  // (the derivatives with respect to alpha_period and alpha_radius). They
+  // are accumulated in double so that 1e8 samples don't lose precision.
+  struct ExpectedSum {
+    static const int size = 10;
+    double value[size];
+
+    ExpectedSum () { std::fill(value, value + size, 0.0); }
+  };
+
+  // Uniform numbers in [0, 1) from a seed and a counter: two rounds of the
+  // splitmix64 finalizer, which is enough to decorrelate consecutive
+  // counters. The result is always computed in double precision so that
+  // the draws are the same for float and double.
+  inline std::uint64_t expected_mix (std::uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+  }
+
+  inline double expected_uniform (std::uint64_t seed, std::uint64_t counter) {
+    return double(expected_mix(seed ^ expected_mix(counter)) >> 11) * (1.0 / 9007199254740992.0);
+  }
+
+  // The samplers: the coordinate k in [0, 4) of sample i in [0, 1), in the
+  // order star, ln P, ln R and b
+  struct ExpectedRandom {
+    std::uint64_t seed;
+
+    double operator() (std::int64_t i, int k) const {
+      return expected_uniform(seed, 4 * std::uint64_t(i) + std::uint64_t(k));
+    }
+  };
+
+  // Owen-scrambled Sobol points; the first 2^m samples stratify the box
+  // (and the stars) so the error falls faster than 1/sqrt(num_samples)
+  struct ExpectedSobol {
+    const SobolSequence& sequence;
+
+    double operator() (std::int64_t i, int k) const {
+      return sequence.uniform<double>(std::uint64_t(i), k);
+    }
+  };
+
+  // Add the samples [begin, end) to sum; search must be a search over the
+  // N durations x of the CDPP table
+  template <typename T, typename Search, typename Sampler>
+  void expected_accumulate (const DetectionModel<T>& model, const ExpectedRate<T>& rate,
+                            const ExpectedBox<T>& box, const ExpectedStars<T>& stars,
+                            Search& search, std::int64_t N, const T* x, const Sampler& sampler,
+                            std::int64_t begin, std::int64_t end, ExpectedSum& sum) {
+    const double ln_min_period = std::log(double(box.min_period)),
+                 ln_period_range = std::log(double(box.max_period)) - ln_min_period,
+                 ln_min_radius = std::log(double(box.min_radius)),
+                 ln_radius_range = std::log(double(box.max_radius)) - ln_min_radius;
+    DetectionGrad<T> grad;
+    for (std::int64_t i = begin; i < end; ++i) {
+      const std::int64_t star = std::min(stars.S - 1, std::int64_t(sampler(i, 0) * double(stars.S)));
+      const T ln_period = T(ln_min_period + ln_period_range * sampler(i, 1));
+      const T ln_radius = T(ln_min_radius + ln_radius_range * sampler(i, 2));
+
+      const DetectionSample<T> sample = {
+        stars.r_star[star], stars.logg_star[star], stars.g1[star], stars.g2[star],
+        stars.dataspan[star], stars.dutycycle[star], exp(ln_radius), exp(ln_period),
+        T(sampler(i, 3)), stars.cdpp + star * N
+      };
+
+      // Most of the box is below the window or the geometric cut; skip the
+      // completeness there
+      const T prior = detection_window<T>(sample) * detection_geometric<T>(sample);
+      if (!(prior > T(0.0))) continue;
+      const T pdet = detection_probability_grad<T>(model, search, N, x, sample, grad);
+      if (!(pdet > T(0.0))) continue;
+
+      const T w = exp(rate.ln_rate + rate.alpha_period * ln_period + rate.alpha_radius * ln_radius) * prior;
+      const double value = double(w * pdet);
+      sum.value[0] += value;
+      sum.value[1] += double(w * grad.model.comp_norm);
+      for (int k = 0; k < 3; ++k) {
+        sum.value[2 + k] += double(w * grad.model.mes0[k]);
+        sum.value[5 + k] += double(w * grad.model.log_sig_mes[k]);
+      }
+      sum.value[8] += value * double(ln_period);
+      sum.value[9] += value * double(ln_radius);
+    }
+  }
+
+  // The factor eff * S * V / num_samples that turns the sum into N_exp
+  template <typename T>
+  double expected_norm (const ExpectedBox<T>& box, std::int64_t S, std::int64_t num_samples,
+                        double efficiency = 1.0) {
+    if (num_samples <= 0) return 0.0;
+    const double V = std::log(double(box.max_period) / double(box.min_period))
+                   * std::log(double(box.max_radius) / double(box.min_radius));
+    return efficiency * double(S) * V / double(num_samples);
+  }
+
+}
+
+#endif
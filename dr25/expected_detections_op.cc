@@ -0,0 +1,203 @@
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+#include "expected.h"
+#include "reduce.h"
+
+using namespace tensorflow;
+
+// Rough cost (in cycles) of one sample: the window and geometric factors and
+// batman::detection_probability_grad for the samples that survive them
+static const int64 kExpectedCostPerElement = 2000;
+
+// The block size for the sums over the samples; see batman::blocked_sum. The
+// only scratch space is one set of partial sums per block.
+static const int64 kExpectedBlockSize = 16384;
+
+REGISTER_OP("ExpectedDetections")
+  .Attr("T: {float, double}")
+  .Attr("num_samples: int = 1000000")
+  .Attr("seed: int = 42")
+  .Attr("quasi: bool = false")
+  .Attr("min_period: float")
+  .Attr("max_period: float")
+  .Attr("min_radius: float")
+  .Attr("max_radius: float")
+  .Attr("efficiency: float = 1.0")
+  .Input("comp_norm: T")
+  .Input("mes0: T")
+  .Input("log_sig_mes: T")
+  .Input("rate: T")
+  .Input("durations: T")
+  .Input("r_star: T")
+  .Input("logg_star: T")
+  .Input("g1: T")
+  .Input("g2: T")
+  .Input("cdpp: T")
+  .Input("dataspan: T")
+  .Input("dutycycle: T")
+  .Output("value: T")
+  .Output("dcomp_norm: T")
+  .Output("dmes0: T")
+  .Output("dlog_sig_mes: T")
+  .Output("drate: T")
+  .SetShapeFn([](shape_inference::InferenceContext* c) {
+    shape_inference::ShapeHandle s, h, x, cdpp;
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &h));
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &h));
+    TF_RETURN_IF_ERROR(c->Merge(h, c->input(2), &h));
+    TF_RETURN_IF_ERROR(c->Merge(h, c->input(3), &h));
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(4), 1, &x));
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(5), 1, &s));
+    for (int k = 6; k < 12; ++k)
+      if (k != 9) TF_RETURN_IF_ERROR(c->Merge(s, c->input(k), &s));
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(9), 2, &cdpp));
+    TF_RETURN_IF_ERROR(c->Concatenate(s, x, &h));
+    TF_RETURN_IF_ERROR(c->Merge(cdpp, h, &cdpp));
+    c->set_output(0, c->Scalar());
+    for (int k = 0; k < 4; ++k) c->set_output(1 + k, c->input(k));
+    return Status::OK();
+  });
+
+template <typename T>
+class ExpectedDetectionsOp : public OpKernel {
+ public:
+  explicit ExpectedDetectionsOp(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("num_samples", &num_samples_));
+    OP_REQUIRES_OK(context, context->GetAttr("seed", &seed_));
+    OP_REQUIRES_OK(context, context->GetAttr("quasi", &quasi_));
+    OP_REQUIRES_OK(context, context->GetAttr("min_period", &min_period_));
+    OP_REQUIRES_OK(context, context->GetAttr("max_period", &max_period_));
+    OP_REQUIRES_OK(context, context->GetAttr("min_radius", &min_radius_));
+    OP_REQUIRES_OK(context, context->GetAttr("max_radius", &max_radius_));
+    OP_REQUIRES_OK(context, context->GetAttr("efficiency", &efficiency_));
+    OP_REQUIRES(context, num_samples_ >= 1, errors::InvalidArgument("'num_samples' must be at least 1"));
+    OP_REQUIRES(context, (!quasi_ || num_samples_ <= (int64(1) << batman::sobol_bits)),
+                errors::InvalidArgument("the Sobol sequence only has 2^32 points"));
+    OP_REQUIRES(context, (min_period_ > 0.0 && max_period_ > min_period_),
+                errors::InvalidArgument("the period range must be positive and non-empty"));
+    OP_REQUIRES(context, (min_radius_ > 0.0 && max_radius_ > min_radius_),
+                errors::InvalidArgument("the radius range must be positive and non-empty"));
+    OP_REQUIRES(context, (efficiency_ >= 0.0), errors::InvalidArgument("'efficiency' must be non-negative"));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    // Inputs
+    const Tensor& comp_norm_tensor = context->input(0);
+    const Tensor& mes0_tensor = context->input(1);
+    const Tensor& log_sig_mes_tensor = context->input(2);
+    const Tensor& rate_tensor = context->input(3);
+    const Tensor& x_tensor = context->input(4);
+    const Tensor& cdpp_tensor = context->input(9);
+
+    OP_REQUIRES(context, (comp_norm_tensor.NumElements() == 1), errors::InvalidArgument("'comp_norm' must be a scalar"));
+    OP_REQUIRES(context, (mes0_tensor.NumElements() == 3), errors::InvalidArgument("'mes0' must have 3 elements"));
+    OP_REQUIRES(context, (log_sig_mes_tensor.NumElements() == 3), errors::InvalidArgument("'log_sig_mes' must have 3 elements"));
+    OP_REQUIRES(context, (rate_tensor.NumElements() == 3), errors::InvalidArgument("'rate' must have 3 elements"));
+    OP_REQUIRES(context, (x_tensor.dims() == 1), errors::InvalidArgument("'durations' must be 1-dimensional"));
+
+    // Dimensions
+    const int64 N = x_tensor.dim_size(0);
+    const int64 S = context->input(5).NumElements();
+    OP_REQUIRES(context, (N >= 2), errors::InvalidArgument("'durations' must have at least 2 elements"));
+    OP_REQUIRES(context, (S >= 1), errors::InvalidArgument("there must be at least one star"));
+    for (int k = 6; k < 12; ++k)
+      if (k != 9) OP_REQUIRES(context, (context->input(k).NumElements() == S), errors::InvalidArgument("all stellar inputs must have matching shapes"));
+    OP_REQUIRES(context, (cdpp_tensor.dims() == 2 && cdpp_tensor.dim_size(0) == S && cdpp_tensor.dim_size(1) == N),
+                errors::InvalidArgument("'cdpp' must have shape (S, N)"));
+
+    // Access the data
+    const auto x = x_tensor.template flat<T>();
+    for (int64 n = 0; n < N - 1; ++n)
+      OP_REQUIRES(context, (x(n+1) > x(n)), errors::InvalidArgument("'durations' must be sorted"));
+
+    batman::DetectionModel<T> model;
+    model.comp_norm = comp_norm_tensor.template flat<T>()(0);
+    for (int k = 0; k < 3; ++k) {
+      model.mes0[k] = mes0_tensor.template flat<T>()(k);
+      model.log_sig_mes[k] = log_sig_mes_tensor.template flat<T>()(k);
+    }
+    const auto rate_flat = rate_tensor.template flat<T>();
+    const batman::ExpectedRate<T> rate = {rate_flat(0), rate_flat(1), rate_flat(2)};
+    const batman::ExpectedBox<T> box = {T(min_period_), T(max_period_), T(min_radius_), T(max_radius_)};
+    const batman::ExpectedStars<T> stars = {
+      S,
+      context->input(5).template flat<T>().data(),
+      context->input(6).template flat<T>().data(),
+      context->input(7).template flat<T>().data(),
+      context->input(8).template flat<T>().data(),
+      cdpp_tensor.template flat<T>().data(),
+      context->input(10).template flat<T>().data(),
+      context->input(11).template flat<T>().data()
+    };
+
+    // Outputs
+    T* out[5];
+    for (int k = 0; k < 5; ++k) {
+      Tensor* out_tensor = NULL;
+      const TensorShape shape = (k == 0) ? TensorShape({}) : context->input(k - 1).shape();
+      OP_REQUIRES_OK(context, context->allocate_output(k, shape, &out_tensor));
+      out[k] = out_tensor->template flat<T>().data();
+    }
+
+    // Each block of samples is drawn, evaluated and summed without storing
+    // anything per sample
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+    auto shard = [&](int64 units, int64 cost, const std::function<void(int64, int64)>& work) {
+      Shard(worker_threads.num_threads, worker_threads.workers, units, cost, work);
+    };
+    const int L = batman::ExpectedSum::size;
+    Tensor partial_tensor;
+    OP_REQUIRES_OK(context, context->allocate_temp(DT_DOUBLE,
+                                                   TensorShape({L, batman::blocked_sum_blocks(num_samples_, kExpectedBlockSize)}),
+                                                   &partial_tensor));
+    const batman::ExpectedRandom random = {std::uint64_t(seed_)};
+    const batman::SobolSequence sequence(4, std::uint64_t(seed_));
+    const batman::ExpectedSobol sobol = {sequence};
+    const batman::InterpSearch<T> search(batman::INTERP_SEARCH_AUTO, N, x.data());
+    auto block = [&](int64, int64 begin, int64 end, double* total) {
+      batman::InterpSearch<T> block_search(search);
+      batman::ExpectedSum sum;
+      if (quasi_)
+        batman::expected_accumulate<T>(model, rate, box, stars, block_search, N, x.data(), sobol, begin, end, sum);
+      else
+        batman::expected_accumulate<T>(model, rate, box, stars, block_search, N, x.data(), random, begin, end, sum);
+      std::copy(sum.value, sum.value + L, total);
+    };
+    double total[L];
+    batman::blocked_sum<L>(1, num_samples_, kExpectedBlockSize, partial_tensor.template flat<double>().data(),
+                           shard, kExpectedCostPerElement, block,
+                           [&](int q, int64, double value) { total[q] = value; });
+
+    // Normalize
+    const double norm = batman::expected_norm<T>(box, S, num_samples_, efficiency_);
+    for (int q = 0; q < L; ++q) total[q] *= norm;
+    out[0][0] = T(total[0]);
+    out[1][0] = T(total[1]);
+    for (int q = 0; q < 3; ++q) {
+      out[2][q] = T(total[2 + q]);
+      out[3][q] = T(total[5 + q]);
+    }
+    out[4][0] = T(total[0]);
+    out[4][1] = T(total[8]);
+    out[4][2] = T(total[9]);
+  }
+
+ private:
+  int64 num_samples_, seed_;
+  bool quasi_;
+  float min_period_, max_period_, min_radius_, max_radius_, efficiency_;
+};
+
+
+#define REGISTER_KERNEL(type)                                                 \
+  REGISTER_KERNEL_BUILDER(                                                    \
+      Name("ExpectedDetections").Device(DEVICE_CPU).TypeConstraint<type>("T"), \
+      ExpectedDetectionsOp<type>)
+
+REGISTER_KERNEL(float);
+REGISTER_KERNEL(double);
+
+#undef REGISTER_KERNEL
@@ -0,0 +1,214 @@
+#ifndef _DR25_INTERP_H_
+#define _DR25_INTERP_H_
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+namespace batman {
+
+  // Strategies for finding the bin of a query in a sorted grid x
+  enum {
+    INTERP_SEARCH_AUTO = 0,     // pick one of the below based on the grid
+    INTERP_SEARCH_BINARY,       // bisection; O(log N) per query
+    INTERP_SEARCH_SCAN,         // branch free compare-and-count; best for small N
+    INTERP_SEARCH_WALK,         // walk from the previous bin; best for sorted queries
+    INTERP_SEARCH_UNIFORM,      // computed index for uniformly spaced x
+    INTERP_SEARCH_LOG_UNIFORM   // computed index for uniformly spaced log(x)
+  };
+
+  // Parse the name of a search strategy; returns -1 if it is not known
+  inline int interp_search_method (const char* name) {
+    if (std::strcmp(name, "auto") == 0) return INTERP_SEARCH_AUTO;
+    if (std::strcmp(name, "binary") == 0) return INTERP_SEARCH_BINARY;
+    if (std::strcmp(name, "scan") == 0) return INTERP_SEARCH_SCAN;
+    if (std::strcmp(name, "walk") == 0) return INTERP_SEARCH_WALK;
+    if (std::strcmp(name, "uniform") == 0) return INTERP_SEARCH_UNIFORM;
+    if (std::strcmp(name, "log_uniform") == 0) return INTERP_SEARCH_LOG_UNIFORM;
+    return -1;
+  }
+
+  // Is x[0], ..., x[N-1] evenly spaced to within a small fraction of the
+  // spacing? The computed index is always corrected afterwards so this only
+  // needs to be close for the correction to be cheap.
+  template <typename T>
+  bool interp_is_uniform (std::int64_t N, const T* x) {
+    if (N < 2) return false;
+    T h = (x[N-1] - x[0]) / (N - 1);
+    if (!(h > 0.0)) return false;
+    for (std::int64_t n = 1; n < N - 1; ++n)
+      if (std::abs(x[n] - (x[0] + n * h)) > 0.01 * h) return false;
+    return true;
+  }
+
+  template <typename T>
+  bool interp_is_log_uniform (std::int64_t N, const T* x) {
+    if (N < 2 || !(x[0] > 0.0)) return false;
+    T l0 = std::log(x[0]), h = (std::log(x[N-1]) - l0) / (N - 1);
+    if (!(h > 0.0)) return false;
+    for (std::int64_t n = 1; n < N - 1; ++n)
+      if (std::abs(std::log(x[n]) - (l0 + n * h)) > 0.01 * h) return false;
+    return true;
+  }
+
+  // The strategy used for INTERP_SEARCH_AUTO. Up to a few dozen points the
+  // scan is as fast as computing the index (and faster than the log for
+  // log-uniform grids). The order of the queries is not inspected so the
+  // walk has to be requested explicitly.
+  template <typename T>
+  int interp_auto_search (std::int64_t N, const T* x) {
+    if (N <= 32) return INTERP_SEARCH_SCAN;
+    if (interp_is_uniform(N, x)) return INTERP_SEARCH_UNIFORM;
+    if (interp_is_log_uniform(N, x)) return INTERP_SEARCH_LOG_UNIFORM;
+    return INTERP_SEARCH_BINARY;
+  }
+
+  // Find the bin of a query in the sorted grid x of length N. For
+  // x[0] < value < x[N-1] every strategy returns exactly the same index as
+  // the binary search: the smallest right with x[right] >= value. Values
+  // outside of that range must be handled by the caller.
+  //
+  // The object holds the state of the walk so each thread should use its
+  // own copy.
+  template <typename T>
+  class InterpSearch {
+   public:
+    InterpSearch (int method, std::int64_t N, const T* x)
+      : method_(method), N_(N), x_(x), x0_(0.0), inv_h_(0.0), last_(1)
+    {
+      if (method_ == INTERP_SEARCH_AUTO) method_ = interp_auto_search(N, x);
+      if (method_ == INTERP_SEARCH_UNIFORM) {
+        x0_ = x[0];
+        inv_h_ = (N - 1) / (x[N-1] - x[0]);
+      } else if (method_ == INTERP_SEARCH_LOG_UNIFORM) {
+        x0_ = std::log(x[0]);
+        inv_h_ = (N - 1) / (std::log(x[N-1]) - x0_);
+      }
+    }
+
+    int method () const { return method_; }
+
+    std::int64_t operator() (const T& value) {
+      switch (method_) {
+        case INTERP_SEARCH_SCAN: return scan(value);
+        case INTERP_SEARCH_WALK: return walk(value);
+        case INTERP_SEARCH_UNIFORM: return fix((value - x0_) * inv_h_, value);
+        case INTERP_SEARCH_LOG_UNIFORM: return fix((std::log(value) - x0_) * inv_h_, value);
+      }
+      return binary(value);
+    }
+
+   private:
+    int method_;
+    std::int64_t N_;
+    const T* x_;
+    T x0_, inv_h_;
+    std::int64_t last_;
+
+    std::int64_t binary (const T& value) const {
+      std::int64_t left = 0, right = N_-1;
+      while (left < right) {
+        std::int64_t middle = left + ((right - left) >> 1);
+        if (x_[middle] < value) {
+          left = middle + 1;
+        } else {
+          right = middle;
+        }
+      }
+      return right;
+    }
+
+    // Since x is sorted, the first x >= value is at the number of elements
+    // that are smaller than value. The loop has no branches and the compiler
+    // vectorizes it.
+    std::int64_t scan (const T& value) const {
+      std::int64_t count = 0;
+      for (std::int64_t n = 0; n < N_; ++n) count += (x_[n] < value);
+      return count;
+    }
+
+    std::int64_t walk (const T& value) {
+      std::int64_t right = last_;
+      while (x_[right] < value) ++right;
+      while (x_[right-1] >= value) --right;
+      last_ = right;
+      return right;
+    }
+
+    // Round the computed fractional index up and correct it by comparing
+    // against the grid so that the rounding error of the index computation
+    // can never change the result
+    std::int64_t fix (const T& u, const T& value) const {
+      std::int64_t right = std::int64_t(std::ceil(u));
+      right = std::max<std::int64_t>(1, std::min<std::int64_t>(right, N_-1));
+      while (x_[right] < value) ++right;
+      while (x_[right-1] >= value) --right;
+      return right;
+    }
+  };
+
+  // Linear interpolation of one row y of the table at value, also returning
+  // the slope dz (zero outside of the grid where the ends are repeated; NaN
+  // queries give NaN)
+  template <typename T, typename Search>
+  void interp_eval (Search& search, const T& value, std::int64_t N, const T* x, const T* y,
+                    T& z, T& dz) {
+    if (value <= x[0]) {
+      dz = T(0.0);
+      z = y[0];
+      return;
+    }
+    if (value >= x[N-1]) {
+      dz = T(0.0);
+      z = y[N-1];
+      return;
+    }
+    if (value != value) {
+      dz = z = value;
+      return;
+    }
+    std::int64_t right = search(value), left = right - 1;
+    dz = (y[right] - y[left]) / (x[right] - x[left]);
+    z = (value - x[left]) * dz + y[left];
+  }
+
+  // The bin of value as the left index and the weight of the right node,
+  // with the derivative of the weight with respect to value. Outside of the
+  // grid the weight is clamped to 0 or 1 (with zero derivative) and NaN
+  // queries give a NaN weight. Requires N >= 2.
+  template <typename T, typename Search>
+  void interp_index_eval (Search& search, const T& value, std::int64_t N, const T* x,
+                          std::int64_t& index, T& weight, T& dweight) {
+    if (value <= x[0]) {
+      index = 0;
+      weight = dweight = T(0.0);
+      return;
+    }
+    if (value >= x[N-1]) {
+      index = N - 2;
+      weight = T(1.0);
+      dweight = T(0.0);
+      return;
+    }
+    if (value != value) {
+      index = 0;
+      weight = dweight = value;
+      return;
+    }
+    std::int64_t right = search(value);
+    index = right - 1;
+    dweight = T(1.0) / (x[right] - x[index]);
+    weight = (value - x[index]) * dweight;
+  }
+
+  // Apply the result of interp_index_eval to one row y of a table. This is
+  // exact at the nodes (weight of 0 or 1).
+  template <typename T>
+  T interp_apply_eval (std::int64_t index, const T& weight, const T* y) {
+    return (T(1.0) - weight) * y[index] + weight * y[index + 1];
+  }
+
+}
+
+#endif
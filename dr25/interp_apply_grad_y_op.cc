@@ -0,0 +1,109 @@
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+#include <atomic>
+
+using namespace tensorflow;
+
+// Rough cost (in cycles) of one row: two stores of each output
+static const int64 kInterpApplyGradYCostPerElement = 10;
+
+// The gradient of InterpApply with respect to the table y in the same sparse
+// form as InterpGradY: indices(m, k) is the position in the row-major
+// (M, N) table and values(m, k) the corresponding element of the gradient.
+// Only the shape of y is used.
+REGISTER_OP("InterpApplyGradY")
+  .Attr("T: {float, double}")
+  .Input("index: int64")
+  .Input("weight: T")
+  .Input("y: T")
+  .Input("bz: T")
+  .Output("indices: int64")
+  .Output("values: T")
+  .SetShapeFn([](shape_inference::InferenceContext* c) {
+    shape_inference::ShapeHandle index, y, out;
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 1, &index));
+    TF_RETURN_IF_ERROR(c->Merge(index, c->input(1), &index));
+    TF_RETURN_IF_ERROR(c->Merge(index, c->input(3), &index));
+    TF_RETURN_IF_ERROR(c->WithRankAtLeast(c->input(2), 1, &y));
+    TF_RETURN_IF_ERROR(c->WithRankAtMost(y, 2, &y));
+    TF_RETURN_IF_ERROR(c->Concatenate(index, c->Vector(2), &out));
+    c->set_output(0, out);
+    c->set_output(1, out);
+    return Status::OK();
+  });
+
+template <typename T>
+class InterpApplyGradYOp : public OpKernel {
+ public:
+  explicit InterpApplyGradYOp(OpKernelConstruction* context) : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    // Inputs
+    const Tensor& index_tensor = context->input(0);
+    const Tensor& weight_tensor = context->input(1);
+    const Tensor& y_tensor = context->input(2);
+    const Tensor& bz_tensor = context->input(3);
+
+    OP_REQUIRES(context, (index_tensor.dims() == 1), errors::InvalidArgument("'index' must be 1-dimensional"));
+    OP_REQUIRES(context, (y_tensor.dims() == 1 || y_tensor.dims() == 2), errors::InvalidArgument("'Y' must be 1- or 2-dimensional"));
+
+    // Dimensions
+    const int64 M = index_tensor.dim_size(0);
+    OP_REQUIRES(context, (weight_tensor.NumElements() == M), errors::InvalidArgument("'index' and 'weight' must have the same shape"));
+    OP_REQUIRES(context, (bz_tensor.NumElements() == M), errors::InvalidArgument("'index' and 'bz' must have the same shape"));
+    int64 N = 0;
+    if (y_tensor.dims() == 2) {
+      OP_REQUIRES(context, (y_tensor.dim_size(0) == M), errors::InvalidArgument("'Y' must have shape (M, N)"));
+      N = y_tensor.dim_size(1);
+    } else if (M > 0) {
+      N = y_tensor.dim_size(0) / M;
+    }
+    OP_REQUIRES(context, (y_tensor.NumElements() == M * N), errors::InvalidArgument("a flattened 'Y' must have shape (M*N,)"));
+
+    // Access the data
+    const auto index = index_tensor.template flat<int64>();
+    const auto weight = weight_tensor.template flat<T>();
+    const auto bz = bz_tensor.template flat<T>();
+
+    // Outputs
+    Tensor* indices_tensor = NULL;
+    Tensor* values_tensor = NULL;
+    OP_REQUIRES_OK(context, context->allocate_output(0, TensorShape({M, 2}), &indices_tensor));
+    OP_REQUIRES_OK(context, context->allocate_output(1, TensorShape({M, 2}), &values_tensor));
+    auto indices = indices_tensor->template matrix<int64>();
+    auto values = values_tensor->template matrix<T>();
+
+    std::atomic<bool> valid(true);
+    auto work = [&](int64 begin, int64 end) {
+      for (int64 m = begin; m < end; ++m) {
+        int64 i = index(m);
+        if (i < 0 || i > N - 2) {
+          valid = false;
+          return;
+        }
+        indices(m, 0) = m * N + i;
+        indices(m, 1) = m * N + i + 1;
+        values(m, 0) = bz(m) * (T(1.0) - weight(m));
+        values(m, 1) = bz(m) * weight(m);
+      }
+    };
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+    Shard(worker_threads.num_threads, worker_threads.workers, M,
+          kInterpApplyGradYCostPerElement, work);
+    OP_REQUIRES(context, valid.load(), errors::InvalidArgument("'index' must be in [0, N-2]"));
+  }
+};
+
+
+#define REGISTER_KERNEL(type)                                              \
+  REGISTER_KERNEL_BUILDER(                                                 \
+      Name("InterpApplyGradY").Device(DEVICE_CPU).TypeConstraint<type>("T"), \
+      InterpApplyGradYOp<type>)
+
+REGISTER_KERNEL(float);
+REGISTER_KERNEL(double);
+
+#undef REGISTER_KERNEL
@@ -0,0 +1,103 @@
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+#include <atomic>
+
+#include "interp.h"
+
+using namespace tensorflow;
+
+// Rough cost (in cycles) of applying one bin: two loads and two multiplies
+static const int64 kInterpApplyCostPerElement = 10;
+
+// Interpolate the rows of y using the bins from InterpIndex. As for Interp,
+// y is either (M, N) or the same table flattened to (M*N,).
+REGISTER_OP("InterpApply")
+  .Attr("T: {float, double}")
+  .Input("index: int64")
+  .Input("weight: T")
+  .Input("y: T")
+  .Output("z: T")
+  .SetShapeFn([](shape_inference::InferenceContext* c) {
+    shape_inference::ShapeHandle index, weight, y;
+    shape_inference::DimensionHandle d;
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 1, &index));
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &weight));
+    TF_RETURN_IF_ERROR(c->WithRankAtLeast(c->input(2), 1, &y));
+    TF_RETURN_IF_ERROR(c->WithRankAtMost(y, 2, &y));
+    TF_RETURN_IF_ERROR(c->Merge(index, weight, &index));
+    if (c->RankKnown(y) && c->Rank(y) == 2) {
+      TF_RETURN_IF_ERROR(c->Merge(c->Dim(index, 0), c->Dim(y, 0), &d));
+    }
+    c->set_output(0, index);
+    return Status::OK();
+  });
+
+template <typename T>
+class InterpApplyOp : public OpKernel {
+ public:
+  explicit InterpApplyOp(OpKernelConstruction* context) : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    // Inputs
+    const Tensor& index_tensor = context->input(0);
+    const Tensor& weight_tensor = context->input(1);
+    const Tensor& y_tensor = context->input(2);
+
+    OP_REQUIRES(context, (index_tensor.dims() == 1), errors::InvalidArgument("'index' must be 1-dimensional"));
+    OP_REQUIRES(context, (weight_tensor.dims() == 1), errors::InvalidArgument("'weight' must be 1-dimensional"));
+    OP_REQUIRES(context, (y_tensor.dims() == 1 || y_tensor.dims() == 2), errors::InvalidArgument("'Y' must be 1- or 2-dimensional"));
+
+    // Dimensions
+    const int64 M = index_tensor.dim_size(0);
+    OP_REQUIRES(context, (weight_tensor.dim_size(0) == M), errors::InvalidArgument("'index' and 'weight' must have the same shape"));
+    int64 N = 0;
+    if (y_tensor.dims() == 2) {
+      OP_REQUIRES(context, (y_tensor.dim_size(0) == M), errors::InvalidArgument("'Y' must have shape (M, N)"));
+      N = y_tensor.dim_size(1);
+    } else if (M > 0) {
+      N = y_tensor.dim_size(0) / M;
+    }
+    OP_REQUIRES(context, (y_tensor.NumElements() == M * N), errors::InvalidArgument("a flattened 'Y' must have shape (M*N,)"));
+
+    // Access the data
+    const auto index = index_tensor.template flat<int64>();
+    const auto weight = weight_tensor.template flat<T>();
+    const auto y = y_tensor.template flat<T>();
+
+    // Output
+    Tensor* z_tensor = NULL;
+    OP_REQUIRES_OK(context, context->allocate_output(0, weight_tensor.shape(), &z_tensor));
+    auto z = z_tensor->template flat<T>();
+
+    // The indices come from the graph so they are checked before use
+    std::atomic<bool> valid(true);
+    auto work = [&](int64 begin, int64 end) {
+      for (int64 m = begin; m < end; ++m) {
+        int64 i = index(m);
+        if (i < 0 || i > N - 2) {
+          valid = false;
+          return;
+        }
+        z(m) = batman::interp_apply_eval<T>(i, weight(m), y.data() + m * N);
+      }
+    };
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+    Shard(worker_threads.num_threads, worker_threads.workers, M,
+          kInterpApplyCostPerElement, work);
+    OP_REQUIRES(context, valid.load(), errors::InvalidArgument("'index' must be in [0, N-2]"));
+  }
+};
+
+
+#define REGISTER_KERNEL(type)                                              \
+  REGISTER_KERNEL_BUILDER(                                                 \
+      Name("InterpApply").Device(DEVICE_CPU).TypeConstraint<type>("T"),    \
+      InterpApplyOp<type>)
+
+REGISTER_KERNEL(float);
+REGISTER_KERNEL(double);
+
+#undef REGISTER_KERNEL
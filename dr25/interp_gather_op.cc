@@ -0,0 +1,142 @@
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+#include <atomic>
+
+#include "interp.h"
+
+using namespace tensorflow;
+
+// Rough cost (in cycles) of one query: the search, a random access into the
+// table and a division
+static const int64 kInterpGatherCostPerElement = 80;
+
+// Like Interp but query m reads row rows(m) of a shared (S, N) table, so the
+// (M, N) table of gathered rows is never formed.
+REGISTER_OP("InterpGather")
+  .Attr("T: {float, double}")
+  .Attr("Tindex: {int32, int64} = DT_INT32")
+  .Attr("check_sorted: bool = true")
+  .Attr("search: {'auto', 'binary', 'scan', 'walk', 'uniform', 'log_uniform'} = 'auto'")
+  .Input("t: T")
+  .Input("x: T")
+  .Input("y: T")
+  .Input("rows: Tindex")
+  .Output("z: T")
+  .Output("dz: T")
+  .SetShapeFn([](shape_inference::InferenceContext* c) {
+    shape_inference::ShapeHandle t, x, y, rows;
+    shape_inference::DimensionHandle d;
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 1, &t));
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &x));
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 2, &y));
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(3), 1, &rows));
+    TF_RETURN_IF_ERROR(c->Merge(t, rows, &t));
+    TF_RETURN_IF_ERROR(c->Merge(c->Dim(x, 0), c->Dim(y, 1), &d));
+    c->set_output(0, t);
+    c->set_output(1, t);
+    return Status::OK();
+  });
+
+template <typename T, typename Tindex>
+class InterpGatherOp : public OpKernel {
+ public:
+  explicit InterpGatherOp(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("check_sorted", &check_sorted_));
+    string search;
+    OP_REQUIRES_OK(context, context->GetAttr("search", &search));
+    search_ = batman::interp_search_method(search.c_str());
+    OP_REQUIRES(context, (search_ >= 0), errors::InvalidArgument("unknown search strategy '", search, "'"));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    // Inputs
+    const Tensor& t_tensor = context->input(0);
+    const Tensor& x_tensor = context->input(1);
+    const Tensor& y_tensor = context->input(2);
+    const Tensor& rows_tensor = context->input(3);
+
+    OP_REQUIRES(context, (t_tensor.dims() == 1), errors::InvalidArgument("'t' must be 1-dimensional"));
+    OP_REQUIRES(context, (x_tensor.dims() == 1), errors::InvalidArgument("'x' must be 1-dimensional"));
+    OP_REQUIRES(context, (y_tensor.dims() == 2), errors::InvalidArgument("'Y' must be 2-dimensional"));
+    OP_REQUIRES(context, (rows_tensor.dims() == 1), errors::InvalidArgument("'rows' must be 1-dimensional"));
+
+    // Dimensions
+    const int64 N = x_tensor.dim_size(0);
+    const int64 M = t_tensor.dim_size(0);
+    const int64 S = y_tensor.dim_size(0);
+    OP_REQUIRES(context, (y_tensor.dim_size(1) == N), errors::InvalidArgument("'Y' must have shape (S, N)"));
+    OP_REQUIRES(context, (rows_tensor.dim_size(0) == M), errors::InvalidArgument("'t' and 'rows' must have the same shape"));
+    OP_REQUIRES(context, (N >= 2), errors::InvalidArgument("'x' must have at least 2 elements"));
+
+    // Access the data
+    const auto t = t_tensor.template flat<T>();
+    const auto x = x_tensor.template flat<T>();
+    const auto y = y_tensor.template flat<T>();
+    const auto rows = rows_tensor.template flat<Tindex>();
+
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+
+    // Check for sorted order
+    if (check_sorted_) {
+      std::atomic<bool> sorted(true);
+      auto check = [&](int64 begin, int64 end) {
+        for (int64 n = begin; n < end; ++n) {
+          if (!(x(n+1) > x(n))) {
+            sorted = false;
+            return;
+          }
+        }
+      };
+      Shard(worker_threads.num_threads, worker_threads.workers, N-1, 1, check);
+      OP_REQUIRES(context, sorted.load(), errors::InvalidArgument("'x' must be sorted"));
+    }
+
+    // Output
+    Tensor* z_tensor = NULL;
+    Tensor* dz_tensor = NULL;
+    OP_REQUIRES_OK(context, context->allocate_output(0, t_tensor.shape(), &z_tensor));
+    OP_REQUIRES_OK(context, context->allocate_output(1, t_tensor.shape(), &dz_tensor));
+    auto z = z_tensor->template flat<T>();
+    auto dz = dz_tensor->template flat<T>();
+
+    const batman::InterpSearch<T> search(search_, N, x.data());
+    OP_REQUIRES(context, (search.method() != batman::INTERP_SEARCH_LOG_UNIFORM || x(0) > 0.0),
+                errors::InvalidArgument("'x' must be positive for the log_uniform search"));
+    std::atomic<bool> valid(true);
+    auto work = [&](int64 begin, int64 end) {
+      batman::InterpSearch<T> shard_search(search);
+      for (int64 m = begin; m < end; ++m) {
+        int64 row = rows(m);
+        if (row < 0 || row >= S) {
+          valid = false;
+          return;
+        }
+        batman::interp_eval<T>(shard_search, t(m), N, x.data(), y.data() + row * N, z(m), dz(m));
+      }
+    };
+    Shard(worker_threads.num_threads, worker_threads.workers, M,
+          kInterpGatherCostPerElement, work);
+    OP_REQUIRES(context, valid.load(), errors::InvalidArgument("'rows' must be in [0, S)"));
+  }
+ private:
+  bool check_sorted_;
+  int search_;
+};
+
+
+#define REGISTER_KERNEL(type, index_type)                                  \
+  REGISTER_KERNEL_BUILDER(                                                 \
+      Name("InterpGather").Device(DEVICE_CPU)                              \
+        .TypeConstraint<type>("T")                                         \
+        .TypeConstraint<index_type>("Tindex"),                             \
+      InterpGatherOp<type, index_type>)
+
+REGISTER_KERNEL(float, int32);
+REGISTER_KERNEL(float, int64);
+REGISTER_KERNEL(double, int32);
+REGISTER_KERNEL(double, int64);
+
+#undef REGISTER_KERNEL
@@ -0,0 +1,129 @@
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+#include <atomic>
+
+#include "interp.h"
+
+using namespace tensorflow;
+
+// Rough cost (in cycles) of finding the bin of one query
+static const int64 kInterpGatherRevCostPerElement = 50;
+
+// The gradient of InterpGather with respect to the shared table y. Many
+// queries can read the same row so the contributions are accumulated in a
+// fixed (serial) order to keep the result independent of the number of
+// threads; only the search is sharded.
+REGISTER_OP("InterpGatherRev")
+  .Attr("T: {float, double}")
+  .Attr("Tindex: {int32, int64} = DT_INT32")
+  .Attr("search: {'auto', 'binary', 'scan', 'walk', 'uniform', 'log_uniform'} = 'auto'")
+  .Input("t: T")
+  .Input("x: T")
+  .Input("y: T")
+  .Input("rows: Tindex")
+  .Input("bz: T")
+  .Output("by: T")
+  .SetShapeFn([](shape_inference::InferenceContext* c) {
+    shape_inference::ShapeHandle y;
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 2, &y));
+    c->set_output(0, y);
+    return Status::OK();
+  });
+
+template <typename T, typename Tindex>
+class InterpGatherRevOp : public OpKernel {
+ public:
+  explicit InterpGatherRevOp(OpKernelConstruction* context) : OpKernel(context) {
+    string search;
+    OP_REQUIRES_OK(context, context->GetAttr("search", &search));
+    search_ = batman::interp_search_method(search.c_str());
+    OP_REQUIRES(context, (search_ >= 0), errors::InvalidArgument("unknown search strategy '", search, "'"));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    // Inputs
+    const Tensor& t_tensor = context->input(0);
+    const Tensor& x_tensor = context->input(1);
+    const Tensor& y_tensor = context->input(2);
+    const Tensor& rows_tensor = context->input(3);
+    const Tensor& bz_tensor = context->input(4);
+
+    OP_REQUIRES(context, (t_tensor.dims() == 1), errors::InvalidArgument("'t' must be 1-dimensional"));
+    OP_REQUIRES(context, (x_tensor.dims() == 1), errors::InvalidArgument("'x' must be 1-dimensional"));
+    OP_REQUIRES(context, (y_tensor.dims() == 2), errors::InvalidArgument("'Y' must be 2-dimensional"));
+
+    // Dimensions
+    const int64 N = x_tensor.dim_size(0);
+    const int64 M = t_tensor.dim_size(0);
+    const int64 S = y_tensor.dim_size(0);
+    OP_REQUIRES(context, (y_tensor.dim_size(1) == N), errors::InvalidArgument("'Y' must have shape (S, N)"));
+    OP_REQUIRES(context, (rows_tensor.NumElements() == M), errors::InvalidArgument("'t' and 'rows' must have the same shape"));
+    OP_REQUIRES(context, (bz_tensor.NumElements() == M), errors::InvalidArgument("'t' and 'bz' must have the same shape"));
+    OP_REQUIRES(context, (N >= 2), errors::InvalidArgument("'x' must have at least 2 elements"));
+
+    // Access the data
+    const auto t = t_tensor.template flat<T>();
+    const auto x = x_tensor.template flat<T>();
+    const auto rows = rows_tensor.template flat<Tindex>();
+    const auto bz = bz_tensor.template flat<T>();
+
+    // Output
+    Tensor* by_tensor = NULL;
+    OP_REQUIRES_OK(context, context->allocate_output(0, y_tensor.shape(), &by_tensor));
+    auto by = by_tensor->template flat<T>();
+    by.setZero();
+
+    // Scratch for the bins
+    Tensor index_tensor, weight_tensor;
+    OP_REQUIRES_OK(context, context->allocate_temp(DT_INT64, TensorShape({M}), &index_tensor));
+    OP_REQUIRES_OK(context, context->allocate_temp(DataTypeToEnum<T>::value, TensorShape({M}), &weight_tensor));
+    auto index = index_tensor.template flat<int64>();
+    auto weight = weight_tensor.template flat<T>();
+
+    // First pass: find the bins in parallel
+    const batman::InterpSearch<T> search(search_, N, x.data());
+    OP_REQUIRES(context, (search.method() != batman::INTERP_SEARCH_LOG_UNIFORM || x(0) > 0.0),
+                errors::InvalidArgument("'x' must be positive for the log_uniform search"));
+    auto work = [&](int64 begin, int64 end) {
+      batman::InterpSearch<T> shard_search(search);
+      for (int64 m = begin; m < end; ++m) {
+        std::int64_t i;
+        T dw;
+        batman::interp_index_eval<T>(shard_search, t(m), N, x.data(), i, weight(m), dw);
+        index(m) = i;
+      }
+    };
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+    Shard(worker_threads.num_threads, worker_threads.workers, M,
+          kInterpGatherRevCostPerElement, work);
+
+    // Second pass: scatter-add into the table in query order
+    for (int64 m = 0; m < M; ++m) {
+      int64 row = rows(m);
+      OP_REQUIRES(context, (row >= 0 && row < S), errors::InvalidArgument("'rows' must be in [0, S)"));
+      int64 k = row * N + index(m);
+      by(k) += bz(m) * (T(1.0) - weight(m));
+      by(k + 1) += bz(m) * weight(m);
+    }
+  }
+ private:
+  int search_;
+};
+
+
+#define REGISTER_KERNEL(type, index_type)                                  \
+  REGISTER_KERNEL_BUILDER(                                                 \
+      Name("InterpGatherRev").Device(DEVICE_CPU)                           \
+        .TypeConstraint<type>("T")                                         \
+        .TypeConstraint<index_type>("Tindex"),                             \
+      InterpGatherRevOp<type, index_type>)
+
+REGISTER_KERNEL(float, int32);
+REGISTER_KERNEL(float, int64);
+REGISTER_KERNEL(double, int32);
+REGISTER_KERNEL(double, int64);
+
+#undef REGISTER_KERNEL
@@ -0,0 +1,108 @@
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+#include "interp.h"
+
+using namespace tensorflow;
+
+// Rough cost (in cycles) of one query: the search and a division
+static const int64 kInterpGradYCostPerElement = 50;
+
+// The gradient of Interp with respect to the table y in sparse form. Each
+// query m only depends on the two nodes of its bin so the gradient has two
+// entries per row: indices(m, k) is the position in the row-major (M, N)
+// table and values(m, k) is the corresponding element of the gradient. The
+// dense (M, N) gradient is never formed.
+REGISTER_OP("InterpGradY")
+  .Attr("T: {float, double}")
+  .Attr("search: {'auto', 'binary', 'scan', 'walk', 'uniform', 'log_uniform'} = 'auto'")
+  .Input("t: T")
+  .Input("x: T")
+  .Input("bz: T")
+  .Output("indices: int64")
+  .Output("values: T")
+  .SetShapeFn([](shape_inference::InferenceContext* c) {
+    shape_inference::ShapeHandle t, x, out;
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 1, &t));
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &x));
+    TF_RETURN_IF_ERROR(c->Merge(t, c->input(2), &t));
+    TF_RETURN_IF_ERROR(c->Concatenate(t, c->Vector(2), &out));
+    c->set_output(0, out);
+    c->set_output(1, out);
+    return Status::OK();
+  });
+
+template <typename T>
+class InterpGradYOp : public OpKernel {
+ public:
+  explicit InterpGradYOp(OpKernelConstruction* context) : OpKernel(context) {
+    string search;
+    OP_REQUIRES_OK(context, context->GetAttr("search", &search));
+    search_ = batman::interp_search_method(search.c_str());
+    OP_REQUIRES(context, (search_ >= 0), errors::InvalidArgument("unknown search strategy '", search, "'"));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    // Inputs
+    const Tensor& t_tensor = context->input(0);
+    const Tensor& x_tensor = context->input(1);
+    const Tensor& bz_tensor = context->input(2);
+
+    OP_REQUIRES(context, (t_tensor.dims() == 1), errors::InvalidArgument("'t' must be 1-dimensional"));
+    OP_REQUIRES(context, (x_tensor.dims() == 1), errors::InvalidArgument("'x' must be 1-dimensional"));
+
+    // Dimensions
+    const int64 N = x_tensor.dim_size(0);
+    const int64 M = t_tensor.dim_size(0);
+    OP_REQUIRES(context, (bz_tensor.NumElements() == M), errors::InvalidArgument("'t' and 'bz' must have the same shape"));
+    OP_REQUIRES(context, (N >= 2), errors::InvalidArgument("'x' must have at least 2 elements"));
+
+    // Access the data
+    const auto t = t_tensor.template flat<T>();
+    const auto x = x_tensor.template flat<T>();
+    const auto bz = bz_tensor.template flat<T>();
+
+    // Outputs
+    Tensor* indices_tensor = NULL;
+    Tensor* values_tensor = NULL;
+    OP_REQUIRES_OK(context, context->allocate_output(0, TensorShape({M, 2}), &indices_tensor));
+    OP_REQUIRES_OK(context, context->allocate_output(1, TensorShape({M, 2}), &values_tensor));
+    auto indices = indices_tensor->template matrix<int64>();
+    auto values = values_tensor->template matrix<T>();
+
+    // The sorted order was already checked by the forward op
+    const batman::InterpSearch<T> search(search_, N, x.data());
+    OP_REQUIRES(context, (search.method() != batman::INTERP_SEARCH_LOG_UNIFORM || x(0) > 0.0),
+                errors::InvalidArgument("'x' must be positive for the log_uniform search"));
+    auto work = [&](int64 begin, int64 end) {
+      batman::InterpSearch<T> shard_search(search);
+      for (int64 m = begin; m < end; ++m) {
+        std::int64_t i;
+        T w, dw;
+        batman::interp_index_eval<T>(shard_search, t(m), N, x.data(), i, w, dw);
+        indices(m, 0) = m * N + i;
+        indices(m, 1) = m * N + i + 1;
+        values(m, 0) = bz(m) * (T(1.0) - w);
+        values(m, 1) = bz(m) * w;
+      }
+    };
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+    Shard(worker_threads.num_threads, worker_threads.workers, M,
+          kInterpGradYCostPerElement, work);
+  }
+ private:
+  int search_;
+};
+
+
+#define REGISTER_KERNEL(type)                                              \
+  REGISTER_KERNEL_BUILDER(                                                 \
+      Name("InterpGradY").Device(DEVICE_CPU).TypeConstraint<type>("T"),    \
+      InterpGradYOp<type>)
+
+REGISTER_KERNEL(float);
+REGISTER_KERNEL(double);
+
+#undef REGISTER_KERNEL
@@ -0,0 +1,121 @@
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+#include <atomic>
+
+#include "interp.h"
+
+using namespace tensorflow;
+
+// Rough cost (in cycles) of one query: the search and a division
+static const int64 kInterpIndexCostPerElement = 50;
+
+// The bins of the queries t in the grid x as the index of the left node and
+// the weight of the right node. These can be applied to any number of
+// tables with InterpApply.
+REGISTER_OP("InterpIndex")
+  .Attr("T: {float, double}")
+  .Attr("check_sorted: bool = true")
+  .Attr("search: {'auto', 'binary', 'scan', 'walk', 'uniform', 'log_uniform'} = 'auto'")
+  .Input("t: T")
+  .Input("x: T")
+  .Output("index: int64")
+  .Output("weight: T")
+  .Output("dweight: T")
+  .SetShapeFn([](shape_inference::InferenceContext* c) {
+    shape_inference::ShapeHandle t, x;
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 1, &t));
+    TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &x));
+    c->set_output(0, t);
+    c->set_output(1, t);
+    c->set_output(2, t);
+    return Status::OK();
+  });
+
+template <typename T>
+class InterpIndexOp : public OpKernel {
+ public:
+  explicit InterpIndexOp(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("check_sorted", &check_sorted_));
+    string search;
+    OP_REQUIRES_OK(context, context->GetAttr("search", &search));
+    search_ = batman::interp_search_method(search.c_str());
+    OP_REQUIRES(context, (search_ >= 0), errors::InvalidArgument("unknown search strategy '", search, "'"));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    // Inputs
+    const Tensor& t_tensor = context->input(0);
+    const Tensor& x_tensor = context->input(1);
+
+    OP_REQUIRES(context, (t_tensor.dims() == 1), errors::InvalidArgument("'t' must be 1-dimensional"));
+    OP_REQUIRES(context, (x_tensor.dims() == 1), errors::InvalidArgument("'x' must be 1-dimensional"));
+
+    // Dimensions
+    const int64 N = x_tensor.dim_size(0);
+    const int64 M = t_tensor.dim_size(0);
+    OP_REQUIRES(context, (N >= 2), errors::InvalidArgument("'x' must have at least 2 elements"));
+
+    // Access the data
+    const auto t = t_tensor.template flat<T>();
+    const auto x = x_tensor.template flat<T>();
+
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+
+    // Check for sorted order
+    if (check_sorted_) {
+      std::atomic<bool> sorted(true);
+      auto check = [&](int64 begin, int64 end) {
+        for (int64 n = begin; n < end; ++n) {
+          if (!(x(n+1) > x(n))) {
+            sorted = false;
+            return;
+          }
+        }
+      };
+      Shard(worker_threads.num_threads, worker_threads.workers, N-1, 1, check);
+      OP_REQUIRES(context, sorted.load(), errors::InvalidArgument("'x' must be sorted"));
+    }
+
+    // Outputs
+    Tensor* index_tensor = NULL;
+    Tensor* weight_tensor = NULL;
+    Tensor* dweight_tensor = NULL;
+    OP_REQUIRES_OK(context, context->allocate_output(0, t_tensor.shape(), &index_tensor));
+    OP_REQUIRES_OK(context, context->allocate_output(1, t_tensor.shape(), &weight_tensor));
+    OP_REQUIRES_OK(context, context->allocate_output(2, t_tensor.shape(), &dweight_tensor));
+    auto index = index_tensor->template flat<int64>();
+    auto weight = weight_tensor->template flat<T>();
+    auto dweight = dweight_tensor->template flat<T>();
+
+    const batman::InterpSearch<T> search(search_, N, x.data());
+    OP_REQUIRES(context, (search.method() != batman::INTERP_SEARCH_LOG_UNIFORM || x(0) > 0.0),
+                errors::InvalidArgument("'x' must be positive for the log_uniform search"));
+    auto work = [&](int64 begin, int64 end) {
+      batman::InterpSearch<T> shard_search(search);
+      for (int64 m = begin; m < end; ++m) {
+        std::int64_t i;
+        batman::interp_index_eval<T>(shard_search, t(m), N, x.data(), i, weight(m), dweight(m));
+        index(m) = i;
+      }
+    };
+    Shard(worker_threads.num_threads, worker_threads.workers, M,
+          kInterpIndexCostPerElement, work);
+  }
+ private:
+  bool check_sorted_;
+  int search_;
+};
+
+
+#define REGISTER_KERNEL(type)                                              \
+  REGISTER_KERNEL_BUILDER(                                                 \
+      Name("InterpIndex").Device(DEVICE_CPU).TypeConstraint<type>("T"),    \
+      InterpIndexOp<type>)
+
+REGISTER_KERNEL(float);
+REGISTER_KERNEL(double);
+
+#undef REGISTER_KERNEL
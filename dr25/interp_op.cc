@@ -1,12 +1,23 @@
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+#include <atomic>
+
+#include "interp.h"
+#include "kernels.h"
 
 using namespace tensorflow;
 
+// Rough cost (in cycles) of one query: the search plus two loads from the
+// row of y and a division
+static const int64 kInterpCostPerElement = 60;
+
 REGISTER_OP("Interp")
   .Attr("T: {float, double}")
   .Attr("check_sorted: bool = true")
+  .Attr("search: {'auto', 'binary', 'scan', 'walk', 'uniform', 'log_uniform'} = 'auto'")
   .Input("t: T")
   .Input("x: T")
   .Input("y: T")
@@ -16,10 +27,14 @@ REGISTER_OP("Interp")
     shape_inference::ShapeHandle t, x, y, y0;
     TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 1, &t));
     TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &x));
-    TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 2, &y));
+    TF_RETURN_IF_ERROR(c->WithRankAtLeast(c->input(2), 1, &y));
+    TF_RETURN_IF_ERROR(c->WithRankAtMost(y, 2, &y));
 
-    TF_RETURN_IF_ERROR(c->Concatenate(t, x, &y0));
-    TF_RETURN_IF_ERROR(c->Merge(y, y0, &y));
+    // y is either (M, N) or the same table flattened to (M*N,)
+    if (c->RankKnown(y) && c->Rank(y) == 2) {
+      TF_RETURN_IF_ERROR(c->Concatenate(t, x, &y0));
+      TF_RETURN_IF_ERROR(c->Merge(y, y0, &y));
+    }
 
     c->set_output(0, t);
     c->set_output(1, t);
@@ -31,6 +46,10 @@ class InterpOp : public OpKernel {
  public:
   explicit InterpOp(OpKernelConstruction* context) : OpKernel(context) {
     OP_REQUIRES_OK(context, context->GetAttr("check_sorted", &check_sorted_));
+    string search;
+    OP_REQUIRES_OK(context, context->GetAttr("search", &search));
+    search_ = batman::interp_search_method(search.c_str());
+    OP_REQUIRES(context, (search_ >= 0), errors::InvalidArgument("unknown search strategy '", search, "'"));
   }
 
   void Compute(OpKernelContext* context) override {
@@ -41,23 +60,40 @@ class InterpOp : public OpKernel {
 
     OP_REQUIRES(context, (t_tensor.dims() == 1), errors::InvalidArgument("'t' must be 1-dimensional"));
     OP_REQUIRES(context, (x_tensor.dims() == 1), errors::InvalidArgument("'x' must be 1-dimensional"));
-    OP_REQUIRES(context, (y_tensor.dims() == 2), errors::InvalidArgument("'Y' must be 2-dimensional"));
+    OP_REQUIRES(context, (y_tensor.dims() == 1 || y_tensor.dims() == 2), errors::InvalidArgument("'Y' must be 1- or 2-dimensional"));
 
     // Dimensions
     const int64 N = x_tensor.dim_size(0);
     const int64 M = t_tensor.dim_size(0);
-    OP_REQUIRES(context, (y_tensor.dim_size(0) == M), errors::InvalidArgument("'Y' must have shape (M, N)"));
-    OP_REQUIRES(context, (y_tensor.dim_size(1) == N), errors::InvalidArgument("'Y' must have shape (M, N)"));
+    if (y_tensor.dims() == 2) {
+      OP_REQUIRES(context, (y_tensor.dim_size(0) == M), errors::InvalidArgument("'Y' must have shape (M, N)"));
+      OP_REQUIRES(context, (y_tensor.dim_size(1) == N), errors::InvalidArgument("'Y' must have shape (M, N)"));
+    } else {
+      OP_REQUIRES(context, (y_tensor.dim_size(0) == M * N), errors::InvalidArgument("a flattened 'Y' must have shape (M*N,)"));
+    }
+    OP_REQUIRES(context, (N >= 1), errors::InvalidArgument("'x' must not be empty"));
 
     // Access the data
     const auto t = t_tensor.template flat<T>();
     const auto x = x_tensor.template flat<T>();
-    const auto y = y_tensor.template matrix<T>();
+    const auto y = y_tensor.template flat<T>();
 
-    // Check for sorted order
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+
+    // Check for sorted order; for the usual small grids Shard runs this
+    // inline
     if (check_sorted_) {
-      for (int64 n = 0; n < N-1; ++n)
-        OP_REQUIRES(context, (x(n+1) > x(n)), errors::InvalidArgument("'x' must be sorted"));
+      std::atomic<bool> sorted(true);
+      auto check = [&](int64 begin, int64 end) {
+        for (int64 n = begin; n < end; ++n) {
+          if (!(x(n+1) > x(n))) {
+            sorted = false;
+            return;
+          }
+        }
+      };
+      Shard(worker_threads.num_threads, worker_threads.workers, N-1, 1, check);
+      OP_REQUIRES(context, sorted.load(), errors::InvalidArgument("'x' must be sorted"));
     }
 
     // Output
@@ -68,34 +104,22 @@ class InterpOp : public OpKernel {
     auto z = z_tensor->template flat<T>();
     auto dz = dz_tensor->template flat<T>();
 
-    for (int64 m = 0; m < M; ++m) {
-      auto value = t(m);
-      if (value <= x(0)) {
-        dz(m) = 0.0;
-        z(m) = y(m, 0);
-        continue;
-      }
-      if (value >= x(N-1)) {
-        dz(m) = 0.0;
-        z(m) = y(m, N-1);
-        continue;
-      }
-      int64 left = 0, right = N-1;
-      while (left < right) {
-        int64 middle = left + ((right - left) >> 1);
-        if (x(middle) < value) {
-          left = middle + 1;
-        } else {
-          right = middle;
-        }
-      }
-      left = right - 1;
-      dz(m) = (y(m, right) - y(m, left)) / (x(right) - x(left));
-      z(m) = (value - x(left)) * dz(m) + y(m, left);
-    }
+    // The strategy is resolved once; each shard then starts a search of its
+    // own so that the walk follows the queries within the shard.
+    const batman::InterpSearch<T> search(search_, N, x.data());
+    OP_REQUIRES(context, (search.method() != batman::INTERP_SEARCH_LOG_UNIFORM || x(0) > 0.0),
+                errors::InvalidArgument("'x' must be positive for the log_uniform search"));
+    const batman::kernel_table<T>& kernels = batman::kernels<T>();
+    const int method = search.method();
+    auto work = [&](int64 begin, int64 end) {
+      kernels.interp(method, begin, end, N, x.data(), t.data(), y.data(), z.data(), dz.data());
+    };
+    Shard(worker_threads.num_threads, worker_threads.workers, M,
+          kInterpCostPerElement, work);
   }
  private:
   bool check_sorted_;
+  int search_;
 };
 
 
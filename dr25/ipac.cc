@@ -0,0 +1,128 @@
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <pybind11/stl.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "ipac.h"
+
+namespace py = pybind11;
+
+namespace {
+
+  py::dtype ipac_dtype (const batman::IpacColumn& column) {
+    if (column.type == batman::IPAC_INT) return py::dtype::of<std::int64_t>();
+    if (column.type == batman::IPAC_DOUBLE) return py::dtype::of<double>();
+    return py::dtype("S" + std::to_string(column.width));
+  }
+
+  // The indices of the requested columns (all of them if columns is None)
+  std::vector<std::size_t> ipac_select (const std::vector<batman::IpacColumn>& all, py::object columns) {
+    std::vector<std::size_t> selected;
+    if (columns.is_none()) {
+      for (std::size_t k = 0; k < all.size(); ++k) selected.push_back(k);
+      return selected;
+    }
+    for (const std::string& name : columns.cast<std::vector<std::string> >()) {
+      std::size_t k = 0;
+      while (k < all.size() && all[k].name != name) ++k;
+      if (k == all.size()) throw py::key_error("no column named '" + name + "'");
+      selected.push_back(k);
+    }
+    return selected;
+  }
+
+  // Read-only arrays that view the columns of a mapped cache and keep the
+  // mapping alive
+  py::dict ipac_columns (const batman::IpacCache& cache, py::object columns) {
+    typedef std::shared_ptr<const batman::IpacMapping> mapping_ptr;
+    py::capsule owner(new mapping_ptr(cache.mapping()), [](void* p) {
+      delete static_cast<mapping_ptr*>(p);
+    });
+    py::dict result;
+    for (std::size_t k : ipac_select(cache.columns(), columns)) {
+      const batman::IpacColumn& column = cache.columns()[k];
+      py::array array(ipac_dtype(column), {ssize_t(cache.rows())}, {ssize_t(column.width)},
+                      cache.data(k), owner);
+      array.attr("setflags")(py::arg("write") = false);
+      result[py::str(column.name)] = array;
+    }
+    return result;
+  }
+
+  py::dict ipac_columns (const batman::IpacTable& table, py::object columns) {
+    py::dict result;
+    for (std::size_t k : ipac_select(table.columns, columns)) {
+      const batman::IpacColumn& column = table.columns[k];
+      result[py::str(column.name)] = py::array(ipac_dtype(column), {ssize_t(table.rows)},
+                                               {ssize_t(column.width)}, table.data[k].data());
+    }
+    return result;
+  }
+
+}
+
+PYBIND11_MODULE(ipac, m) {
+  // Read the columns of an IPAC (or whitespace separated) table as a dict
+  // of numpy arrays; see ipac.h for the types and null values. With cache
+  // (True for path + ".cache", or a file name) the parsed table is saved to
+  // a columnar cache that later calls map instead of parsing as long as
+  // the size and modification time of path and names are unchanged; the
+  // arrays are then read-only views of the cache. A cache that can't be
+  // written only gives a RuntimeWarning. columns selects and orders the
+  // columns, names names the columns of a whitespace separated table and
+  // num_threads <= 0 parses on all of the hardware threads.
+  m.def("read", [](const std::string& path, py::object columns, py::object cache,
+                   py::object names, int num_threads) {
+    std::string cache_path;
+    if (py::isinstance<py::str>(cache)) {
+      cache_path = cache.cast<std::string>();
+    } else if (!cache.is_none() && cache.cast<bool>()) {
+      cache_path = path + ".cache";
+    }
+    std::vector<std::string> column_names;
+    if (!names.is_none()) column_names = names.cast<std::vector<std::string> >();
+
+    const batman::IpacStamp stamp = batman::ipac_stamp(path, column_names);
+    if (!cache_path.empty()) {
+      std::unique_ptr<batman::IpacCache> mapped;
+      try {
+        mapped.reset(new batman::IpacCache(cache_path));
+      } catch (const std::runtime_error&) {}
+      if (mapped && mapped->stamp() == stamp)
+        return ipac_columns(*mapped, columns);
+    }
+
+    // Caching is best effort: if the cache can't be written (e.g. the data
+    // directory is read-only) the parsed table is returned with a warning
+    batman::IpacTable table;
+    std::string cache_error;
+    {
+      py::gil_scoped_release release;
+      table = batman::ipac_read(path, column_names, num_threads);
+      if (!cache_path.empty()) {
+        try {
+          batman::ipac_write_cache(table, stamp, cache_path);
+        } catch (const std::runtime_error& e) {
+          cache_error = e.what();
+        }
+      }
+    }
+    if (!cache_error.empty()) {
+      py::module::import("warnings").attr("warn")(cache_error, py::handle(PyExc_RuntimeWarning));
+      return ipac_columns(table, columns);
+    }
+    if (cache_path.empty()) return ipac_columns(table, columns);
+    std::unique_ptr<batman::IpacCache> written;
+    try {
+      written.reset(new batman::IpacCache(cache_path));
+    } catch (const std::runtime_error&) {
+      return ipac_columns(table, columns);
+    }
+    return ipac_columns(*written, columns);
+  }, py::arg("path"), py::arg("columns") = py::none(), py::arg("cache") = true,
+     py::arg("names") = py::none(), py::arg("num_threads") = 0);
+}
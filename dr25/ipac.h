@@ -0,0 +1,601 @@
+#ifndef _DR25_IPAC_H_
+#define _DR25_IPAC_H_
+
+#include <cctype>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "parallel.h"
+
+namespace batman {
+
+  // A reader for the tables that get_data.sh downloads. The stellar and KOI
+  // tables are IPAC tables: "\" keyword and comment lines, then up to four
+  // "|" delimited header lines (names, types, units and nulls) whose bars
+  // give the fixed character range of each column in the data lines. The
+  // injection tables (kplr_dr25_inj*_plti.txt) are whitespace separated
+  // numbers under "#" comment lines; their columns are read as double.
+  //
+  // The file is memory mapped, split into chunks at line boundaries and
+  // parsed on num_threads threads: one pass counts the rows of each chunk
+  // and a second pass parses every chunk straight into its rows of the
+  // columns. Integers are int64 (ipac_int_null for null values), reals are
+  // double (NaN for null values) and strings are fixed width, null padded
+  // byte strings (empty for null values).
+  //
+  // A parsed table can be written to a columnar cache file that is memory
+  // mapped by IpacCache: each column is one contiguous, aligned array, so
+  // loading the cache is only the mapping and selecting a column only
+  // touches its pages. The cache records the size and modification time of
+  // the source so that it can be checked before it is used.
+
+  enum IpacType {
+    IPAC_INT = 0,
+    IPAC_DOUBLE = 1,
+    IPAC_STRING = 2
+  };
+
+  const std::int64_t ipac_int_null = std::numeric_limits<std::int64_t>::min();
+
+  struct IpacColumn {
+    std::string name;
+    IpacType type;
+    std::int64_t width;       // The bytes per value
+    std::int64_t begin, end;  // The characters of a data line (IPAC only)
+    std::string null;         // The null value (IPAC only)
+  };
+
+  // What a parsed table depends on: the size and modification time
+  // (seconds and nanoseconds) of the file, since whole seconds alone miss a
+  // table that is rewritten within a second, and a hash of the column names
+  // passed to ipac_read (0 for none)
+  struct IpacStamp {
+    std::int64_t size, mtime, mtime_nsec;
+    std::uint64_t names;
+  };
+
+  inline bool operator== (const IpacStamp& a, const IpacStamp& b) {
+    return a.size == b.size && a.mtime == b.mtime && a.mtime_nsec == b.mtime_nsec
+        && a.names == b.names;
+  }
+
+  // The FNV-1a hash of the names, each preceded by its length
+  inline std::uint64_t ipac_names_hash (const std::vector<std::string>& names) {
+    if (names.empty()) return 0;
+    std::uint64_t h = 0xcbf29ce484222325ull;
+    auto mix = [&](unsigned char c) { h = (h ^ c) * 0x100000001b3ull; };
+    for (const std::string& name : names) {
+      const std::uint64_t n = name.size();
+      for (int b = 0; b < 8; ++b) mix((unsigned char)(n >> (8 * b)));
+      for (char c : name) mix((unsigned char)c);
+    }
+    return h;
+  }
+
+  inline IpacStamp ipac_stamp (const std::string& path,
+                               const std::vector<std::string>& names = std::vector<std::string>()) {
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0)
+      throw std::runtime_error("could not stat '" + path + "'");
+#ifdef __APPLE__
+    const std::int64_t nsec = st.st_mtimespec.tv_nsec;
+#else
+    const std::int64_t nsec = st.st_mtim.tv_nsec;
+#endif
+    IpacStamp stamp = {std::int64_t(st.st_size), std::int64_t(st.st_mtime), nsec,
+                       ipac_names_hash(names)};
+    return stamp;
+  }
+
+  // A read-only mapping of a whole file
+  class IpacMapping {
+   public:
+    explicit IpacMapping (const std::string& path) : data_(NULL), size_(0) {
+      int fd = ::open(path.c_str(), O_RDONLY);
+      if (fd < 0) throw std::runtime_error("could not open '" + path + "'");
+      struct stat st;
+      if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("could not stat '" + path + "'");
+      }
+      size_ = std::size_t(st.st_size);
+      if (size_ > 0) {
+        void* data = ::mmap(NULL, size_, PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) {
+          ::close(fd);
+          throw std::runtime_error("could not map '" + path + "'");
+        }
+        data_ = static_cast<const char*>(data);
+      }
+      ::close(fd);
+    }
+
+    ~IpacMapping () {
+      if (data_ != NULL) ::munmap(const_cast<char*>(data_), size_);
+    }
+
+    IpacMapping (const IpacMapping&) = delete;
+    IpacMapping& operator= (const IpacMapping&) = delete;
+
+    const char* data () const { return data_; }
+    std::size_t size () const { return size_; }
+
+   private:
+    const char* data_;
+    std::size_t size_;
+  };
+
+  // A parsed table; data[k] holds rows * columns[k].width bytes
+  struct IpacTable {
+    std::int64_t rows;
+    std::vector<IpacColumn> columns;
+    std::vector<std::vector<char> > data;
+  };
+
+  namespace detail {
+
+    inline bool ipac_is_space (char c) {
+      return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    inline void ipac_trim (const char*& begin, const char*& end) {
+      while (begin < end && ipac_is_space(*begin)) ++begin;
+      while (end > begin && ipac_is_space(end[-1])) --end;
+    }
+
+    inline std::string ipac_trimmed (const char* begin, const char* end) {
+      ipac_trim(begin, end);
+      return std::string(begin, end);
+    }
+
+    inline const char* ipac_line_end (const char* begin, const char* end) {
+      const char* p = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+      return (p == NULL) ? end : p;
+    }
+
+    // Data lines are the lines that aren't blank, keywords, headers or
+    // comments
+    inline bool ipac_is_row (const char* begin, const char* end) {
+      ipac_trim(begin, end);
+      return begin < end && *begin != '\\' && *begin != '|' && *begin != '#';
+    }
+
+    // Call func(line_begin, line_end) for each data line in [begin, end),
+    // without the line break
+    template <typename F>
+    void ipac_for_each_row (const char* begin, const char* end, F func) {
+      while (begin < end) {
+        const char* line_end = ipac_line_end(begin, end);
+        const char* e = line_end;
+        if (e > begin && e[-1] == '\r') --e;
+        if (ipac_is_row(begin, e)) func(begin, e);
+        begin = line_end + 1;
+      }
+    }
+
+    inline IpacType ipac_type (std::string type) {
+      std::transform(type.begin(), type.end(), type.begin(), ::tolower);
+      if (type.empty()) return IPAC_DOUBLE;
+      if (type.compare(0, 2, "da") == 0 || type[0] == 'c') return IPAC_STRING;
+      if (type[0] == 'i' || type[0] == 'l') return IPAC_INT;
+      if (type[0] == 'd' || type[0] == 'f' || type[0] == 'r') return IPAC_DOUBLE;
+      throw std::runtime_error("unknown IPAC column type '" + type + "'");
+    }
+
+    // Decimal numbers with at most 15 significant digits and a power of ten
+    // within 1e22 are exact doubles over an exact power of ten, so one
+    // multiplication or division rounds them correctly (Clinger's fast
+    // path); that covers the tables and skips strtod. Anything else is
+    // left to strtod.
+    inline bool ipac_parse_double (const char* begin, const char* end, double& value) {
+      static const double powers[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+      };
+      const char* p = begin;
+      const bool negative = p < end && *p == '-';
+      if (p < end && (*p == '-' || *p == '+')) ++p;
+      std::uint64_t mantissa = 0;
+      int digits = 0, exponent = 0;
+      const char* start = p;
+      for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+        if (digits || *p != '0') ++digits;
+        mantissa = 10 * mantissa + std::uint64_t(*p - '0');
+        if (digits > 15) return false;
+      }
+      if (p < end && *p == '.') {
+        for (++p; p < end && *p >= '0' && *p <= '9'; ++p) {
+          if (digits || *p != '0') ++digits;
+          mantissa = 10 * mantissa + std::uint64_t(*p - '0');
+          --exponent;
+          if (digits > 15) return false;
+        }
+      }
+      if (p == start || (p == start + 1 && *start == '.')) return false;
+      if (p < end && (*p == 'e' || *p == 'E')) {
+        ++p;
+        const bool negative_exponent = p < end && *p == '-';
+        if (p < end && (*p == '-' || *p == '+')) ++p;
+        if (p == end) return false;
+        int e = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+          e = 10 * e + (*p - '0');
+          if (e > 1000) return false;
+        }
+        exponent += negative_exponent ? -e : e;
+      }
+      if (p != end || exponent < -22 || exponent > 22) return false;
+      value = double(mantissa);
+      value = (exponent < 0) ? value / powers[-exponent] : value * powers[exponent];
+      if (negative) value = -value;
+      return true;
+    }
+
+    // Parse one value into out (width bytes); false if it isn't a valid
+    // value of the column's type
+    inline bool ipac_parse_value (const IpacColumn& column, const char* begin, const char* end, char* out) {
+      ipac_trim(begin, end);
+      const std::size_t n = end - begin;
+      if (column.type == IPAC_STRING) {
+        if (std::int64_t(n) > column.width) return false;
+        if (column.null.size() == n && std::equal(begin, end, column.null.begin())) begin = end;
+        std::memset(out, 0, column.width);
+        std::memcpy(out, begin, end - begin);
+        return true;
+      }
+
+      const bool null = n == 0 || (column.null.size() == n && std::equal(begin, end, column.null.begin()))
+                     || (n == 4 && std::strncmp(begin, "null", 4) == 0);
+      if (column.type == IPAC_INT) {
+        std::int64_t value = ipac_int_null;
+        if (!null) {
+          char buffer[32];
+          if (n >= sizeof(buffer)) return false;
+          std::memcpy(buffer, begin, n);
+          buffer[n] = '\0';
+          char* parsed;
+          value = std::strtoll(buffer, &parsed, 10);
+          if (parsed != buffer + n) return false;
+        }
+        std::memcpy(out, &value, sizeof(value));
+      } else {
+        double value = std::numeric_limits<double>::quiet_NaN();
+        if (!null && !ipac_parse_double(begin, end, value)) {
+          char buffer[64];
+          if (n >= sizeof(buffer)) return false;
+          std::memcpy(buffer, begin, n);
+          buffer[n] = '\0';
+          char* parsed;
+          value = std::strtod(buffer, &parsed);
+          if (parsed != buffer + n) return false;
+        }
+        std::memcpy(out, &value, sizeof(value));
+      }
+      return true;
+    }
+
+    // The "|" header of an IPAC table and the offset of the first line
+    // after it. Without a "|" header the table is whitespace separated and
+    // the columns come from the first data line and names.
+    inline std::size_t ipac_parse_header (const char* data, std::size_t size,
+                                          const std::vector<std::string>& names,
+                                          std::vector<IpacColumn>& columns, bool& fixed_width) {
+      const char *begin = data, *end = data + size;
+      std::vector<std::string> header;
+      std::size_t offset = 0;
+      while (begin < end) {
+        const char* line_end = ipac_line_end(begin, end);
+        std::string line(begin, line_end);
+        if (!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+        if (!line.empty() && line[0] == '|') {
+          header.push_back(line);
+        } else if (!header.empty() || ipac_is_row(begin, line_end)) {
+          break;
+        }
+        begin = line_end + 1;
+        offset = std::min(size, std::size_t(begin - data));
+      }
+
+      columns.clear();
+      fixed_width = !header.empty();
+      if (fixed_width) {
+        std::vector<std::size_t> bars;
+        for (std::size_t i = 0; i < header[0].size(); ++i)
+          if (header[0][i] == '|') bars.push_back(i);
+        if (bars.size() < 2) throw std::runtime_error("the IPAC header has no columns");
+        auto field = [&](std::size_t line, std::size_t k) {
+          if (line >= header.size() || bars[k] + 1 >= header[line].size()) return std::string();
+          const std::string& h = header[line];
+          std::size_t e = std::min(h.size(), bars[k + 1]);
+          return ipac_trimmed(h.data() + bars[k] + 1, h.data() + e);
+        };
+        for (std::size_t k = 0; k + 1 < bars.size(); ++k) {
+          IpacColumn column;
+          column.name = field(0, k);
+          column.type = ipac_type(field(1, k));
+          column.begin = std::int64_t(bars[k]) + 1;
+          column.end = std::int64_t(bars[k + 1]);
+          column.width = (column.type == IPAC_STRING) ? std::max<std::int64_t>(1, column.end - column.begin) : 8;
+          column.null = field(3, k);
+          columns.push_back(column);
+        }
+        return offset;
+      }
+
+      // The number of columns of a whitespace separated table is that of
+      // its first data line
+      std::size_t count = 0;
+      bool found = false;
+      ipac_for_each_row(data, end, [&](const char* b, const char* e) {
+        if (found) return;
+        found = true;
+        for (const char* p = b; p < e;) {
+          while (p < e && ipac_is_space(*p)) ++p;
+          if (p == e) break;
+          ++count;
+          while (p < e && !ipac_is_space(*p)) ++p;
+        }
+      });
+      if (!names.empty() && names.size() != count)
+        throw std::runtime_error("the number of names doesn't match the number of columns");
+      for (std::size_t k = 0; k < count; ++k) {
+        IpacColumn column;
+        column.name = names.empty() ? "col" + std::to_string(k + 1) : names[k];
+        column.type = IPAC_DOUBLE;
+        column.width = 8;
+        column.begin = column.end = 0;
+        columns.push_back(column);
+      }
+      return 0;
+    }
+
+  }
+
+  // Parse the table in data; if names is given it names the columns of a
+  // whitespace separated table
+  inline IpacTable ipac_parse (const char* data, std::size_t size,
+                               const std::vector<std::string>& names, int num_threads) {
+    IpacTable table;
+    bool fixed_width;
+    const std::size_t offset = detail::ipac_parse_header(data, size, names, table.columns, fixed_width);
+    const std::int64_t C = std::int64_t(table.columns.size());
+    const char *begin = data + offset, *end = data + size;
+
+    // Split the data into chunks at line boundaries; a few per thread so
+    // that uneven lines still balance
+    if (num_threads <= 0) num_threads = std::max<int>(1, std::thread::hardware_concurrency());
+    const std::int64_t target = std::max<std::int64_t>(1, std::min<std::int64_t>(
+        4 * std::int64_t(num_threads), (end - begin) / (1 << 16)));
+    std::vector<const char*> bounds(1, begin);
+    for (std::int64_t k = 1; k < target; ++k) {
+      const char* p = std::max(bounds.back(), begin + (end - begin) * k / target);
+      p = detail::ipac_line_end(p, end);
+      if (p < end) ++p;
+      if (p > bounds.back() && p < end) bounds.push_back(p);
+    }
+    bounds.push_back(end);
+    const std::int64_t K = std::int64_t(bounds.size()) - 1;
+
+    // First pass: the rows in each chunk
+    std::vector<std::int64_t> first(K + 1, 0);
+    parallel_for(K, num_threads, 1, [&](std::int64_t b, std::int64_t e) {
+      for (std::int64_t k = b; k < e; ++k) {
+        std::int64_t count = 0;
+        detail::ipac_for_each_row(bounds[k], bounds[k + 1], [&](const char*, const char*) { ++count; });
+        first[k + 1] = count;
+      }
+    });
+    for (std::int64_t k = 0; k < K; ++k) first[k + 1] += first[k];
+    table.rows = first[K];
+    table.data.resize(C);
+    for (std::int64_t c = 0; c < C; ++c) table.data[c].resize(table.rows * table.columns[c].width);
+
+    // Second pass: parse each chunk into its rows, recording the first
+    // value that doesn't parse (a column of -1 is a line with the wrong
+    // number of values)
+    std::vector<std::int64_t> bad_row(K, -1), bad_column(K, -1);
+    parallel_for(K, num_threads, 1, [&](std::int64_t b, std::int64_t e) {
+      for (std::int64_t k = b; k < e; ++k) {
+        std::int64_t row = first[k];
+        detail::ipac_for_each_row(bounds[k], bounds[k + 1], [&](const char* lb, const char* le) {
+          const std::int64_t length = le - lb;
+          const char* p = lb;
+          for (std::int64_t c = 0; c < C && bad_row[k] < 0; ++c) {
+            const IpacColumn& column = table.columns[c];
+            const char *vb, *ve;
+            if (fixed_width) {
+              vb = lb + std::min(length, column.begin);
+              ve = lb + std::min(length, column.end);
+            } else {
+              while (p < le && detail::ipac_is_space(*p)) ++p;
+              vb = p;
+              while (p < le && !detail::ipac_is_space(*p)) ++p;
+              ve = p;
+              if (vb == ve) {
+                bad_row[k] = row;
+                break;
+              }
+            }
+            if (!detail::ipac_parse_value(column, vb, ve, table.data[c].data() + row * column.width)) {
+              bad_row[k] = row;
+              bad_column[k] = c;
+            }
+          }
+          if (!fixed_width && bad_row[k] < 0) {
+            while (p < le && detail::ipac_is_space(*p)) ++p;
+            if (p < le) bad_row[k] = row;
+          }
+          ++row;
+        });
+      }
+    });
+    for (std::int64_t k = 0; k < K; ++k) {
+      if (bad_row[k] < 0) continue;
+      if (bad_column[k] < 0)
+        throw std::runtime_error("data row " + std::to_string(bad_row[k] + 1) + " has the wrong number of values");
+      throw std::runtime_error("could not parse the value of '" + table.columns[bad_column[k]].name
+                               + "' in data row " + std::to_string(bad_row[k] + 1));
+    }
+    return table;
+  }
+
+  inline IpacTable ipac_read (const std::string& path, const std::vector<std::string>& names, int num_threads) {
+    IpacMapping mapping(path);
+    return ipac_parse(mapping.data(), mapping.size(), names, num_threads);
+  }
+
+  // The cache file: a header, the column directory and then the columns,
+  // each aligned to ipac_cache_alignment bytes. Everything is in the byte
+  // order of the machine that wrote it.
+  const char ipac_cache_magic[8] = {'D', 'R', '2', '5', 'I', 'P', 'A', 'C'};
+  const std::uint32_t ipac_cache_version = 3;
+  const std::int64_t ipac_cache_alignment = 64;
+
+  namespace detail {
+
+    struct IpacCacheHeader {
+      char magic[8];
+      std::uint32_t version, columns;
+      std::int64_t rows, source_size, source_mtime, source_mtime_nsec;
+      std::uint64_t source_names;
+    };
+
+    struct IpacCacheEntry {
+      std::uint32_t type, name_size;
+      std::int64_t width, offset;
+    };
+
+    inline std::int64_t ipac_align (std::int64_t n, std::int64_t alignment) {
+      return (n + alignment - 1) / alignment * alignment;
+    }
+
+  }
+
+  // Write table to path, through a temporary file that is renamed into
+  // place so that a reader never sees a partial cache
+  inline void ipac_write_cache (const IpacTable& table, const IpacStamp& source, const std::string& path) {
+    const std::int64_t C = std::int64_t(table.columns.size());
+
+    detail::IpacCacheHeader header;
+    std::memcpy(header.magic, ipac_cache_magic, sizeof(header.magic));
+    header.version = ipac_cache_version;
+    header.columns = std::uint32_t(C);
+    header.rows = table.rows;
+    header.source_size = source.size;
+    header.source_mtime = source.mtime;
+    header.source_mtime_nsec = source.mtime_nsec;
+    header.source_names = source.names;
+
+    std::vector<detail::IpacCacheEntry> entries(C);
+    std::int64_t offset = sizeof(header);
+    for (std::int64_t c = 0; c < C; ++c)
+      offset += sizeof(detail::IpacCacheEntry) + detail::ipac_align(table.columns[c].name.size(), 8);
+    for (std::int64_t c = 0; c < C; ++c) {
+      offset = detail::ipac_align(offset, ipac_cache_alignment);
+      entries[c].type = std::uint32_t(table.columns[c].type);
+      entries[c].name_size = std::uint32_t(table.columns[c].name.size());
+      entries[c].width = table.columns[c].width;
+      entries[c].offset = offset;
+      offset += table.rows * table.columns[c].width;
+    }
+
+    const std::string tmp = path + ".tmp" + std::to_string(::getpid());
+    std::FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (f == NULL) throw std::runtime_error("could not write '" + tmp + "'");
+    const char zeros[ipac_cache_alignment] = {0};
+    std::int64_t position = 0;
+    bool ok = true;
+    auto write = [&](const void* data, std::int64_t n) {
+      if (n > 0) ok = ok && std::fwrite(data, 1, n, f) == std::size_t(n);
+      position += n;
+    };
+    write(&header, sizeof(header));
+    for (std::int64_t c = 0; c < C; ++c) {
+      write(&entries[c], sizeof(entries[c]));
+      write(table.columns[c].name.data(), entries[c].name_size);
+      write(zeros, detail::ipac_align(entries[c].name_size, 8) - entries[c].name_size);
+    }
+    for (std::int64_t c = 0; c < C; ++c) {
+      write(zeros, entries[c].offset - position);
+      write(table.data[c].data(), table.rows * table.columns[c].width);
+    }
+    ok = (std::fclose(f) == 0) && ok;
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+      std::remove(tmp.c_str());
+      throw std::runtime_error("could not write '" + path + "'");
+    }
+  }
+
+  // A mapped cache file. The columns point into the mapping, which stays
+  // alive as long as any copy of mapping() does.
+  class IpacCache {
+   public:
+    explicit IpacCache (const std::string& path) : mapping_(std::make_shared<IpacMapping>(path)) {
+      const char *data = mapping_->data(), *end = data + mapping_->size();
+      detail::IpacCacheHeader header;
+      if (mapping_->size() < sizeof(header)) invalid(path);
+      std::memcpy(&header, data, sizeof(header));
+      if (std::memcmp(header.magic, ipac_cache_magic, sizeof(header.magic)) != 0
+          || header.version != ipac_cache_version || header.rows < 0)
+        invalid(path);
+      rows_ = header.rows;
+      stamp_.size = header.source_size;
+      stamp_.mtime = header.source_mtime;
+      stamp_.mtime_nsec = header.source_mtime_nsec;
+      stamp_.names = header.source_names;
+
+      const char* p = data + sizeof(header);
+      for (std::uint32_t c = 0; c < header.columns; ++c) {
+        detail::IpacCacheEntry entry;
+        if (end - p < std::int64_t(sizeof(entry))) invalid(path);
+        std::memcpy(&entry, p, sizeof(entry));
+        p += sizeof(entry);
+        if (entry.type > IPAC_STRING || entry.width <= 0 || end - p < std::int64_t(entry.name_size)
+            || entry.offset % ipac_cache_alignment != 0 || entry.offset > std::int64_t(mapping_->size())
+            || rows_ * entry.width > std::int64_t(mapping_->size()) - entry.offset)
+          invalid(path);
+        IpacColumn column;
+        column.name = std::string(p, entry.name_size);
+        column.type = IpacType(entry.type);
+        column.width = entry.width;
+        column.begin = column.end = 0;
+        p += detail::ipac_align(entry.name_size, 8);
+        columns_.push_back(column);
+        data_.push_back(data + entry.offset);
+      }
+    }
+
+    std::int64_t rows () const { return rows_; }
+    const IpacStamp& stamp () const { return stamp_; }
+    const std::vector<IpacColumn>& columns () const { return columns_; }
+    const char* data (std::size_t k) const { return data_[k]; }
+    std::shared_ptr<const IpacMapping> mapping () const { return mapping_; }
+
+   private:
+    std::shared_ptr<const IpacMapping> mapping_;
+    std::int64_t rows_;
+    IpacStamp stamp_;
+    std::vector<IpacColumn> columns_;
+    std::vector<const char*> data_;
+
+    static void invalid (const std::string& path) {
+      throw std::runtime_error("'" + path + "' is not a valid table cache");
+    }
+  };
+
+}
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef _DR25_KEPLER_H_
+#define _DR25_KEPLER_H_
+
+#include <cmath>
+#include <limits>
+#include <cstdint>
+#include <algorithm>
+
+namespace batman {
+
+  using std::abs;
+  using std::sin;
+  using std::cos;
+  using std::sqrt;
+  using std::atan2;
+  using std::floor;
+  using std::copysign;
+
+  // The number of Danby iterations in kepler_solve_batch. Starting from
+  // E = M + 0.85 e sign(M) the residual |E - e sin E - M| after 4 iterations
+  // is at the rounding level of double (and float) for e < 0.99; it grows to
+  // about 1e-8 for e = 0.998 very close to periastron.
+  const int kepler_iterations = 4;
+
+  // The number of elements that kepler_solve_batch iterates together. The
+  // iterations are one long chain of dependent divisions, so a single
+  // element is limited by latency; interleaving independent elements (and
+  // SIMD lanes once the compiler vectorizes the inner loops) hides it.
+  const std::int64_t kepler_block_size = 64;
+
+  // sin(x) and cos(x) for |x| <= 1 from their Taylor series, with an error
+  // below 1e-17. This is how the solver updates the sine and cosine of E by
+  // each step, so that only sin(M) and cos(M) need the math library and the
+  // iterations are plain arithmetic.
+  template <typename T>
+  inline void kepler_sincos_step (const T& x, T& s, T& c) {
+    T x2 = x * x;
+    s = x * (T(1.0) + x2 * (T(-1.0/6.0) + x2 * (T(1.0/120.0) + x2 * (T(-1.0/5040.0)
+          + x2 * (T(1.0/362880.0) + x2 * (T(-1.0/39916800.0) + x2 * (T(1.0/6227020800.0)
+          + x2 * (T(-1.0/1307674368000.0) + x2 * T(1.0/355687428096000.0)))))))));
+    c = T(1.0) + x2 * (T(-1.0/2.0) + x2 * (T(1.0/24.0) + x2 * (T(-1.0/720.0)
+          + x2 * (T(1.0/40320.0) + x2 * (T(-1.0/3628800.0) + x2 * (T(1.0/479001600.0)
+          + x2 * (T(-1.0/87178291200.0) + x2 * (T(1.0/20922789888000.0)
+          + x2 * T(-1.0/6402373705728000.0)))))))));
+  }
+
+  // The eccentric anomalies E (and sin E and cos E) for n mean anomalies M
+  // in [-pi, pi] and one eccentricity 0 <= e < 1. The number of iterations
+  // is fixed and there are no branches, so every element costs the same;
+  // the steps are at most 0.85 so kepler_sincos_step applies.
+  template <typename T>
+  void kepler_solve_batch (std::int64_t n, const T& e, const T* M, T* E, T* sinE, T* cosE) {
+    for (std::int64_t i = 0; i < n; ++i) {
+      sinE[i] = sin(M[i]);
+      cosE[i] = cos(M[i]);
+    }
+    const T step = T(0.85) * e;
+    T s, c;
+    for (std::int64_t i = 0; i < n; ++i) {
+      T d = copysign(step, M[i]);
+      kepler_sincos_step<T>(d, s, c);
+      T sinM = sinE[i], cosM = cosE[i];
+      E[i] = M[i] + d;
+      sinE[i] = sinM * c + cosM * s;
+      cosE[i] = cosM * c - sinM * s;
+    }
+    for (int k = 0; k < kepler_iterations; ++k) {
+      for (std::int64_t i = 0; i < n; ++i) {
+        T se = e * sinE[i], ce = e * cosE[i];
+        T f0 = E[i] - se - M[i], f1 = T(1.0) - ce;
+        T d1 = -f0 / f1;
+        T d2 = -f0 / (f1 + T(0.5) * d1 * se);
+        T d3 = -f0 / (f1 + T(0.5) * d2 * se + d2 * d2 * ce / T(6.0));
+        kepler_sincos_step<T>(d3, s, c);
+        T sinE0 = sinE[i], cosE0 = cosE[i];
+        E[i] += d3;
+        sinE[i] = sinE0 * c + cosE0 * s;
+        cosE[i] = cosE0 * c - sinE0 * s;
+      }
+    }
+  }
+
+  // The sky separation (in units of the stellar radius) of a planet on an
+  // eccentric orbit and its partial derivatives. The orbit is given by the
+  // time of a mid-transit t0, the period, the eccentricity e, the argument
+  // of periastron omega (radians), the semi-major axis a (stellar radii)
+  // and the inclination incl (radians). With the true anomaly f the planet
+  // is at
+  //
+  //   X = -r cos(omega + f),  Y = -r sin(omega + f) cos(incl)
+  //
+  // on the sky and in front of the star when sin(omega + f) > 0; the
+  // mid-transit is at f = pi/2 - omega. Everything that only depends on the
+  // star is computed once by the constructor. The separation is +inf (and
+  // the derivatives 0) while the planet is behind the star.
+  template <typename T>
+  class KeplerOrbit {
+   public:
+    KeplerOrbit (const T& t0, const T& period, const T& e, const T& omega,
+                 const T& a, const T& incl)
+      : t0_(t0), period_(period), e_(e), a_(a),
+        sin_omega_(sin(omega)), cos_omega_(cos(omega)),
+        sin_incl_(sin(incl)), cos_incl_(cos(incl)) {
+      n_ = T(2.0 * M_PI) / period;
+      sqrt1me2_ = sqrt(T(1.0) - e * e);
+
+      // The mean anomaly at mid-transit and its derivatives with respect to
+      // e (at fixed f) and f
+      T sft = cos_omega_, cft = sin_omega_;
+      T Et = atan2(sqrt1me2_ * sft, e + cft);
+      Mt_ = Et - e * sin(Et);
+      T denom = T(1.0) + e * cft;
+      Mt_e_ = -sft * (T(2.0) + e * cft) * sqrt1me2_ / (denom * denom);
+      Mt_omega_ = -sqrt1me2_ * sqrt1me2_ * sqrt1me2_ / (denom * denom);
+    }
+
+    // The separation at the time t
+    T operator() (const T& t) const {
+      T z, dt0, dperiod, de, domega, da, dincl;
+      grad(1, &t, &z, &dt0, &dperiod, &de, &domega, &da, &dincl);
+      return z;
+    }
+
+    // The separations z at the n times t and their partial derivatives with
+    // respect to t0, the period, e, omega, a and incl. The derivative with
+    // respect to the period includes the number of orbits since t0.
+    void grad (std::int64_t n, const T* t, T* z, T* dt0, T* dperiod, T* de,
+               T* domega, T* da, T* dincl) const {
+      T M[kepler_block_size], E[kepler_block_size], sinE[kepler_block_size], cosE[kepler_block_size];
+      for (std::int64_t begin = 0; begin < n; begin += kepler_block_size) {
+        std::int64_t size = std::min(kepler_block_size, n - begin);
+
+        // The mean anomalies wrapped to [-pi, pi]
+        for (std::int64_t i = 0; i < size; ++i) {
+          T m = n_ * (t[begin + i] - t0_) + Mt_;
+          M[i] = m - T(2.0 * M_PI) * floor(m / T(2.0 * M_PI) + T(0.5));
+        }
+        kepler_solve_batch<T>(size, e_, M, E, sinE, cosE);
+
+        for (std::int64_t i = 0; i < size; ++i) {
+          std::int64_t j = begin + i;
+          T ecosE = T(1.0) - e_ * cosE[i];
+          T r = a_ * ecosE;
+          T cosf = (cosE[i] - e_) / ecosE, sinf = sqrt1me2_ * sinE[i] / ecosE;
+          T sinpsi = sin_omega_ * cosf + cos_omega_ * sinf,
+            cospsi = cos_omega_ * cosf - sin_omega_ * sinf;
+          T y = sinpsi * cos_incl_;
+          T w = sqrt(cospsi * cospsi + y * y), zj = r * w;
+
+          // The separation as a function of r, psi = omega + f and incl
+          T w_inv = T(1.0) / w;
+          T z_r = w, z_psi = -r * sinpsi * cospsi * sin_incl_ * sin_incl_ * w_inv,
+            z_incl = -r * sinpsi * sinpsi * sin_incl_ * cos_incl_ * w_inv;
+
+          // r and f as functions of the mean anomaly and e
+          T r_M = a_ * e_ * sinf / sqrt1me2_, r_e = -a_ * cosf;
+          T ecosf = T(1.0) + e_ * cosf;
+          T f_M = ecosf * ecosf / (sqrt1me2_ * sqrt1me2_ * sqrt1me2_),
+            f_e = sinf * (T(2.0) + e_ * cosf) / (sqrt1me2_ * sqrt1me2_);
+          T z_M = z_r * r_M + z_psi * f_M;
+
+          // The mean anomaly is n (t - t0) + Mt(e, omega); everything is
+          // masked out behind the star and at z = 0 where the direction is
+          // undefined
+          bool front = sinpsi > T(0.0), inside = front && zj > T(0.0);
+          z[j] = front ? zj : std::numeric_limits<T>::infinity();
+          dt0[j] = inside ? -n_ * z_M : T(0.0);
+          dperiod[j] = inside ? -n_ * (t[j] - t0_) / period_ * z_M : T(0.0);
+          de[j] = inside ? z_r * r_e + z_psi * f_e + z_M * Mt_e_ : T(0.0);
+          domega[j] = inside ? z_psi + z_M * Mt_omega_ : T(0.0);
+          da[j] = inside ? zj / a_ : T(0.0);
+          dincl[j] = inside ? z_incl : T(0.0);
+        }
+      }
+    }
+
+   private:
+    T t0_, period_, e_, a_, sin_omega_, cos_omega_, sin_incl_, cos_incl_;
+    T n_, sqrt1me2_, Mt_, Mt_e_, Mt_omega_;
+  };
+
+}
+
+#endif
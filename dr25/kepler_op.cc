@@ -0,0 +1,108 @@
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+#include "kernels.h"
+
+using namespace tensorflow;
+
+// Rough cost (in cycles) of one element: four Danby iterations with a sin
+// and a cos each plus the chain rule back to the orbital elements
+static const int64 kKeplerCostPerElement = 600;
+
+REGISTER_OP("KeplerSeparation")
+  .Attr("T: {float, double}")
+  .Input("t0: T")
+  .Input("period: T")
+  .Input("e: T")
+  .Input("omega: T")
+  .Input("a: T")
+  .Input("incl: T")
+  .Input("t: T")
+  .Output("z: T")
+  .Output("dt0: T")
+  .Output("dperiod: T")
+  .Output("de: T")
+  .Output("domega: T")
+  .Output("da: T")
+  .Output("dincl: T")
+  .SetShapeFn([](shape_inference::InferenceContext* c) {
+    shape_inference::ShapeHandle s;
+    shape_inference::DimensionHandle d;
+    TF_RETURN_IF_ERROR(c->Merge(c->input(0), c->input(1), &s));
+    for (int k = 2; k < 6; ++k) TF_RETURN_IF_ERROR(c->Merge(s, c->input(k), &s));
+    TF_RETURN_IF_ERROR(c->Merge(c->Dim(s, 0), c->Dim(c->input(6), 0), &d));
+    for (int k = 0; k < 7; ++k) c->set_output(k, c->input(6));
+    return Status::OK();
+  });
+
+template <typename T>
+class KeplerSeparationOp : public OpKernel {
+ public:
+  explicit KeplerSeparationOp(OpKernelConstruction* context) : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    // Inputs
+    const Tensor& t0_tensor = context->input(0);
+    const Tensor& period_tensor = context->input(1);
+    const Tensor& e_tensor = context->input(2);
+    const Tensor& omega_tensor = context->input(3);
+    const Tensor& a_tensor = context->input(4);
+    const Tensor& incl_tensor = context->input(5);
+    const Tensor& t_tensor = context->input(6);
+
+    // Dimensions
+    int64 N = t0_tensor.NumElements();
+    int64 M = 1;
+    if (t_tensor.dims() > t0_tensor.dims()) {
+      OP_REQUIRES(context, (t_tensor.dims() == t0_tensor.dims() + 1), errors::InvalidArgument("invalid dimensions"));
+      M = t_tensor.dim_size(t_tensor.dims() - 1);
+    }
+    for (int k = 1; k < 6; ++k)
+      OP_REQUIRES(context, (context->input(k).NumElements() == N), errors::InvalidArgument("all inputs must have matching shapes"));
+    OP_REQUIRES(context, (t_tensor.NumElements() == N * M), errors::InvalidArgument("all inputs must have matching shapes"));
+
+    // Access the data
+    const auto t0 = t0_tensor.template flat<T>();
+    const auto period = period_tensor.template flat<T>();
+    const auto e = e_tensor.template flat<T>();
+    const auto omega = omega_tensor.template flat<T>();
+    const auto a = a_tensor.template flat<T>();
+    const auto incl = incl_tensor.template flat<T>();
+    const auto t = t_tensor.template flat<T>();
+
+    // The solver assumes bound orbits
+    for (int64 n = 0; n < N; ++n)
+      OP_REQUIRES(context, (e(n) >= T(0.0) && e(n) < T(1.0)), errors::InvalidArgument("'e' must be in [0, 1)"));
+
+    // Outputs
+    T* out[7];
+    for (int k = 0; k < 7; ++k) {
+      Tensor* out_tensor = NULL;
+      OP_REQUIRES_OK(context, context->allocate_output(k, t_tensor.shape(), &out_tensor));
+      out[k] = out_tensor->template flat<T>().data();
+    }
+
+    const batman::kernel_table<T>& kernels = batman::kernels<T>();
+    auto work = [&](int64 begin, int64 end) {
+      kernels.kepler(begin, end, M, t0.data(), period.data(), e.data(), omega.data(),
+                     a.data(), incl.data(), t.data(),
+                     out[0], out[1], out[2], out[3], out[4], out[5], out[6]);
+    };
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+    Shard(worker_threads.num_threads, worker_threads.workers, N * M,
+          kKeplerCostPerElement, work);
+  }
+};
+
+
+#define REGISTER_KERNEL(type)                                                 \
+  REGISTER_KERNEL_BUILDER(                                                    \
+      Name("KeplerSeparation").Device(DEVICE_CPU).TypeConstraint<type>("T"),  \
+      KeplerSeparationOp<type>)
+
+REGISTER_KERNEL(float);
+REGISTER_KERNEL(double);
+
+#undef REGISTER_KERNEL
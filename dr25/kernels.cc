@@ -0,0 +1,63 @@
+#include <cstdlib>
+#include <cstring>
+
+#include "kernels.h"
+
+namespace batman {
+
+  namespace detail {
+
+    enum {
+      ISA_GENERIC = 0,
+      ISA_AVX2,
+      ISA_AVX512
+    };
+
+    // The highest level allowed by DR25_ISA; no limit if it isn't set or
+    // isn't recognized
+    inline int max_isa () {
+      const char* name = std::getenv("DR25_ISA");
+      if (name == NULL) return ISA_AVX512;
+      if (std::strcmp(name, "generic") == 0) return ISA_GENERIC;
+      if (std::strcmp(name, "avx2") == 0) return ISA_AVX2;
+      return ISA_AVX512;
+    }
+
+    // The highest level that the CPU (and the operating system, which has to
+    // save the wider registers) supports
+    inline int cpu_isa () {
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") &&
+            __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512bw"))
+          return ISA_AVX512;
+        return ISA_AVX2;
+      }
+#endif
+      return ISA_GENERIC;
+    }
+
+    template <typename T>
+    const kernel_table<T>* select_kernels () {
+      int isa = cpu_isa(), limit = max_isa();
+      if (limit < isa) isa = limit;
+      const kernel_table<T>* table = NULL;
+      if (isa >= ISA_AVX512) table = kernels_avx512<T>();
+      if (table == NULL && isa >= ISA_AVX2) table = kernels_avx2<T>();
+      if (table == NULL) table = kernels_generic<T>();
+      return table;
+    }
+
+  }
+
+  template <typename T>
+  const kernel_table<T>& kernels () {
+    static const kernel_table<T>* table = detail::select_kernels<T>();
+    return *table;
+  }
+
+  template const kernel_table<float>& kernels<float> ();
+  template const kernel_table<double>& kernels<double> ();
+
+}
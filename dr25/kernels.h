@@ -0,0 +1,57 @@
+#ifndef _DR25_KERNELS_H_
+#define _DR25_KERNELS_H_
+
+#include <cstdint>
+
+namespace batman {
+
+  // The hot loops compiled for one instruction set level. Each entry
+  // evaluates the flattened elements [begin, end) with the same layout as
+  // quad_batch: z (and the outputs) have N * M elements and the per-star
+  // parameters are indexed by i / M. For interp, y has a row of N values
+  // per query and method must already be resolved (not INTERP_SEARCH_AUTO).
+  // transit is transit_flux (see transit.h) with t in place of z and kepler
+  // is KeplerOrbit::grad (see kepler.h).
+  template <typename T>
+  struct kernel_table {
+    const char* isa;
+    void (*quad_batch) (std::int64_t begin, std::int64_t end, std::int64_t M,
+                        const T* c1, const T* c2, const T* p, const T* z, T* flux);
+    void (*quad_bucketed) (std::int64_t begin, std::int64_t end, std::int64_t M,
+                           const T* c1, const T* c2, const T* p, const T* z, T* flux);
+    void (*quad_basis_batch) (std::int64_t begin, std::int64_t end, std::int64_t M,
+                              const T* p, const T* z, T* lambdae, T* lambdad, T* etad);
+    void (*quad_grad) (std::int64_t begin, std::int64_t end, std::int64_t M,
+                       const T* c1, const T* c2, const T* p, const T* z,
+                       T* flux, T* dc1, T* dc2, T* dp, T* dz);
+    void (*interp) (int method, std::int64_t begin, std::int64_t end, std::int64_t N,
+                    const T* x, const T* t, const T* y, T* z, T* dz);
+    void (*transit) (std::int64_t begin, std::int64_t end, std::int64_t M,
+                     const T* g1, const T* g2, const T* p, const T* t0, const T* period,
+                     const T* a, const T* b, const T* t, T texp, int K, T* flux);
+    void (*kepler) (std::int64_t begin, std::int64_t end, std::int64_t M,
+                    const T* t0, const T* period, const T* e, const T* omega,
+                    const T* a, const T* incl, const T* t, T* z,
+                    T* dt0, T* dperiod, T* de, T* domega, T* da, T* dincl);
+  };
+
+  // The table for the best instruction set that both the compiler and the
+  // CPU support, chosen on the first call. The DR25_ISA environment variable
+  // (generic, avx2 or avx512) can select a lower level, e.g. for comparing
+  // the results or timing.
+  template <typename T>
+  const kernel_table<T>& kernels ();
+
+  namespace detail {
+
+    // Defined in kernels_<isa>.cc; NULL if the compiler can't target the
+    // instruction set
+    template <typename T> const kernel_table<T>* kernels_generic ();
+    template <typename T> const kernel_table<T>* kernels_avx2 ();
+    template <typename T> const kernel_table<T>* kernels_avx512 ();
+
+  }
+
+}
+
+#endif
@@ -0,0 +1,36 @@
+// The kernels for x86-64 with AVX2 and FMA (Haswell, Zen and later). The
+// packets in simd.h are 4 doubles or 8 floats wide.
+//
+// The target is set with a pragma (not -m flags) so that this file can be
+// built with the same flags as the rest of the extension; only GCC supports
+// it, so with other compilers this instruction set is left out.
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__)
+
+#define DR25_KERNELS_NAMESPACE isa_avx2
+#define DR25_KERNELS_TARGET "avx2,fma"
+#define DR25_SIMD_LEVEL 2
+#define DR25_KERNELS_ISA "avx2"
+#define DR25_KERNELS_GETTER kernels_avx2
+#include "kernels_impl.h"
+
+#else
+
+#include <cstddef>
+#include "kernels.h"
+
+namespace batman {
+  namespace detail {
+
+    template <typename T>
+    const kernel_table<T>* kernels_avx2 () {
+      return NULL;
+    }
+
+    template const kernel_table<float>* kernels_avx2<float> ();
+    template const kernel_table<double>* kernels_avx2<double> ();
+
+  }
+}
+
+#endif
@@ -0,0 +1,39 @@
+// The kernels for x86-64 with AVX-512 F, VL, DQ and BW (Skylake-SP, Ice
+// Lake, Zen 4 and later). The packets in simd.h are 8 doubles or 16 floats
+// wide. VL and DQ matter even though the packets only need F: without them
+// GCC falls back to slow sequences for the scalar float <-> double
+// conversions, which made the float quad about twice as slow as with AVX2.
+//
+// The target is set with a pragma (not -m flags) so that this file can be
+// built with the same flags as the rest of the extension; only GCC supports
+// it, so with other compilers this instruction set is left out.
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__)
+
+#define DR25_KERNELS_NAMESPACE isa_avx512
+#define DR25_KERNELS_TARGET "avx2,fma,avx512f,avx512vl,avx512dq,avx512bw"
+#define DR25_SIMD_LEVEL 3
+#define DR25_KERNELS_ISA "avx512"
+#define DR25_KERNELS_GETTER kernels_avx512
+#include "kernels_impl.h"
+
+#else
+
+#include <cstddef>
+#include "kernels.h"
+
+namespace batman {
+  namespace detail {
+
+    template <typename T>
+    const kernel_table<T>* kernels_avx512 () {
+      return NULL;
+    }
+
+    template const kernel_table<float>* kernels_avx512<float> ();
+    template const kernel_table<double>* kernels_avx512<double> ();
+
+  }
+}
+
+#endif
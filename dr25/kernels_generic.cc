@@ -0,0 +1,7 @@
+// The kernels for the baseline instruction set that the extension is
+// compiled for (SSE2 on x86-64)
+
+#define DR25_KERNELS_NAMESPACE isa_generic
+#define DR25_KERNELS_ISA "generic"
+#define DR25_KERNELS_GETTER kernels_generic
+#include "kernels_impl.h"
@@ -0,0 +1,138 @@
+#ifndef _DR25_KERNELS_IMPL_H_
+#define _DR25_KERNELS_IMPL_H_
+
+// The kernel table for one instruction set; included once by each
+// kernels_<isa>.cc after defining
+//
+//   DR25_KERNELS_NAMESPACE  a namespace to wrap the batman headers in
+//   DR25_KERNELS_TARGET     the GCC target string (optional)
+//   DR25_SIMD_LEVEL         the matching packets in simd.h (optional)
+//   DR25_KERNELS_ISA        the name reported in kernel_table::isa
+//   DR25_KERNELS_GETTER     the detail::kernels_<isa> function to define
+//
+// The headers are wrapped in a namespace of their own so that the template
+// instantiations compiled for different targets are distinct symbols;
+// otherwise the linker would be free to keep, say, the AVX-512 copy of
+// batman::quad<double> for every caller.
+
+// Anything that the headers include from outside of dr25 has to be seen
+// first, outside of both the namespace and the target
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "kernels.h"
+
+#ifdef DR25_KERNELS_TARGET
+#define DR25_PRAGMA(x) _Pragma(#x)
+#define DR25_TARGET_PRAGMA(isa) DR25_PRAGMA(GCC target(isa))
+#pragma GCC push_options
+DR25_TARGET_PRAGMA(DR25_KERNELS_TARGET)
+#endif
+
+namespace DR25_KERNELS_NAMESPACE {
+
+#include "quad_batch.h"
+#include "quad_bucket.h"
+#include "quad_grad.h"
+#include "interp.h"
+#include "transit.h"
+#include "kepler.h"
+
+  template <typename T>
+  struct kernel_impl {
+    static void quad_batch (std::int64_t begin, std::int64_t end, std::int64_t M,
+                            const T* c1, const T* c2, const T* p, const T* z, T* flux) {
+      batman::quad_batch<T>(begin, end, M, c1, c2, p, z, flux);
+    }
+
+    static void quad_bucketed (std::int64_t begin, std::int64_t end, std::int64_t M,
+                               const T* c1, const T* c2, const T* p, const T* z, T* flux) {
+      batman::quad_bucketed<T>(begin, end, M, c1, c2, p, z, flux);
+    }
+
+    static void quad_basis_batch (std::int64_t begin, std::int64_t end, std::int64_t M,
+                                  const T* p, const T* z, T* lambdae, T* lambdad, T* etad) {
+      batman::quad_basis_batch<T>(begin, end, M, p, z, lambdae, lambdad, etad);
+    }
+
+    static void quad_grad (std::int64_t begin, std::int64_t end, std::int64_t M,
+                           const T* c1, const T* c2, const T* p, const T* z,
+                           T* flux, T* dc1, T* dc2, T* dp, T* dz) {
+      for (std::int64_t i = begin; i < end; ++i) {
+        std::int64_t n = i / M;
+        flux[i] = batman::quad_grad<T>(c1[n], c2[n], p[n], z[i], dc1[i], dc2[i], dp[i], dz[i]);
+      }
+    }
+
+    static void interp (int method, std::int64_t begin, std::int64_t end, std::int64_t N,
+                        const T* x, const T* t, const T* y, T* z, T* dz) {
+      batman::InterpSearch<T> search(method, N, x);
+      for (std::int64_t m = begin; m < end; ++m)
+        batman::interp_eval<T>(search, t[m], N, x, y + m * N, z[m], dz[m]);
+    }
+
+    static void transit (std::int64_t begin, std::int64_t end, std::int64_t M,
+                         const T* g1, const T* g2, const T* p, const T* t0, const T* period,
+                         const T* a, const T* b, const T* t, T texp, int K, T* flux) {
+      // The window only depends on the star so it is computed once per row
+      std::int64_t n = -1;
+      T half_window = T(0.0);
+      for (std::int64_t i = begin; i < end; ++i) {
+        if (i / M != n) {
+          n = i / M;
+          half_window = batman::transit_half_window<T>(p[n], period[n], a[n], texp);
+        }
+        flux[i] = batman::transit_flux<T>(g1[n], g2[n], p[n], t0[n], period[n], a[n], b[n], t[i],
+                                          texp, K, half_window);
+      }
+    }
+
+    static void kepler (std::int64_t begin, std::int64_t end, std::int64_t M,
+                        const T* t0, const T* period, const T* e, const T* omega,
+                        const T* a, const T* incl, const T* t, T* z,
+                        T* dt0, T* dperiod, T* de, T* domega, T* da, T* dincl) {
+      for (std::int64_t i = begin; i < end;) {
+        std::int64_t n = i / M, row_end = std::min(end, (n + 1) * M);
+        const batman::KeplerOrbit<T> orbit(t0[n], period[n], e[n], omega[n], a[n], incl[n]);
+        orbit.grad(row_end - i, t + i, z + i, dt0 + i, dperiod + i, de + i, domega + i, da + i, dincl + i);
+        i = row_end;
+      }
+    }
+
+    static const ::batman::kernel_table<T> table;
+  };
+
+  template <typename T>
+  const ::batman::kernel_table<T> kernel_impl<T>::table = {
+    DR25_KERNELS_ISA, quad_batch, quad_bucketed, quad_basis_batch, quad_grad, interp, transit, kepler
+  };
+
+}
+
+#ifdef DR25_KERNELS_TARGET
+#pragma GCC pop_options
+#undef DR25_TARGET_PRAGMA
+#undef DR25_PRAGMA
+#endif
+
+namespace batman {
+  namespace detail {
+
+    template <typename T>
+    const kernel_table<T>* DR25_KERNELS_GETTER () {
+      return &DR25_KERNELS_NAMESPACE::kernel_impl<T>::table;
+    }
+
+    template const kernel_table<float>* DR25_KERNELS_GETTER<float> ();
+    template const kernel_table<double>* DR25_KERNELS_GETTER<double> ();
+
+  }
+}
+
+#endif
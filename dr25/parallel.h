@@ -0,0 +1,37 @@
+#ifndef _DR25_PARALLEL_H_
+#define _DR25_PARALLEL_H_
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+namespace batman {
+
+  // Split [0, total) into contiguous ranges of at least grain elements and
+  // call func(begin, end) for each range on its own std::thread, with the
+  // calling thread taking the first range. This is for callers outside of
+  // TensorFlow (the ops use the intra-op thread pool instead). If
+  // num_threads <= 0 the number of hardware threads is used.
+  template <typename F>
+  void parallel_for (std::int64_t total, int num_threads, std::int64_t grain, F func) {
+    if (total <= 0) return;
+    if (num_threads <= 0) num_threads = std::max<int>(1, std::thread::hardware_concurrency());
+    std::int64_t max_ranges = std::max<std::int64_t>(1, total / std::max<std::int64_t>(1, grain));
+    int num_ranges = int(std::min<std::int64_t>(num_threads, max_ranges));
+    if (num_ranges <= 1) {
+      func(std::int64_t(0), total);
+      return;
+    }
+
+    std::int64_t step = (total + num_ranges - 1) / num_ranges;
+    std::vector<std::thread> threads;
+    for (std::int64_t begin = step; begin < total; begin += step)
+      threads.emplace_back(func, begin, std::min(total, begin + step));
+    func(std::int64_t(0), step);
+    for (auto& thread : threads) thread.join();
+  }
+
+}
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef _DR25_PRECISION_H_
+#define _DR25_PRECISION_H_
+
+namespace batman {
+
+  // The underlying floating point type of T. Constants are written as
+  // scalar_type<T>::type so that float code stays in single precision and
+  // AutoDiff types (see ellint_grad.h) combine constants with plain scalars
+  // instead of constructing AutoDiff constants.
+  template <typename T>
+  struct scalar_type {
+    typedef T type;
+  };
+
+  // Convergence settings for the Bulirsch iterations in ellint.h and
+  // ellint_batch.h. The iterations converge quadratically so the error in
+  // the result is roughly tol^2 relative: about 1e-16 for double and about
+  // 1e-8 (below the float epsilon of 6e-8) for float. The iteration caps
+  // only matter for non-finite or out of range arguments; the iterations
+  // converge in under 10 steps for 0 <= k < 1 - 1e-12 (double) and
+  // 0 <= k < 1 - 1e-6 (float).
+  template <typename T>
+  struct ellint_precision {
+    static constexpr double tol = 1.0e-8;
+    static constexpr int max_iter = 200;
+  };
+
+  template <>
+  struct ellint_precision<float> {
+    static constexpr float tol = 1.0e-4f;
+    static constexpr int max_iter = 50;
+  };
+
+  // Accuracy of the float gradient (quad_grad.h, QuadTable::operator()).
+  // Away from the contact points the partials with respect to p and z
+  // agree with the double ones to about 1e-6 of the largest partial (1e-3
+  // in the worst 0.1% of random samples). The partials are discontinuous
+  // where d = p and |1 - d| = p, and within about 1e-2 of these kinks the
+  // rounding of d and p to float decides which side is evaluated and how
+  // much of the elliptic integrals cancels: there the error grows to
+  // order 1 of the largest partial at |d - p| or ||1 - d| - p| ~ 1e-4 and
+  // up to ~1e3 relative for |d - p| < 3e-7 (about 1 in 1000 random samples
+  // exceed 1e-3 relative). Use double when the gradient near contact
+  // matters, e.g. for grazing or ingress-dominated fits.
+
+}
+
+#endif
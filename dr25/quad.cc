@@ -1,10 +1,159 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/numpy.h>
 
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+
 #include "quad.h"
+#include "quad_batch.h"
+#include "kernels.h"
+#include "quad_table.h"
+#include "parallel.h"
 
 namespace py = pybind11;
 
+namespace {
+
+  // Below this many elements per thread it isn't worth starting threads
+  const std::int64_t kQuadBatchGrain = 4096;
+  const std::int64_t kQuadGradGrain = 2048;
+
+  // quad for broadcast (c1, c2, p, z) computed in precision T. The inputs
+  // are cast to C contiguous arrays of T, which only copies the ones that
+  // aren't already (and inputs that are broadcast up to the full shape).
+  // The result is written to out if given, which must then be a C
+  // contiguous, writeable array of T with the broadcast shape; it may be
+  // one of the inputs. The GIL is released while computing.
+  template <typename T>
+  py::array quad_batch (py::object c1, py::object c2, py::object p, py::object z,
+                        py::object out, int num_threads) {
+    typedef py::array_t<T, py::array::c_style | py::array::forcecast> input_array;
+    typedef py::array_t<T, py::array::c_style> output_array;
+
+    py::tuple arrays = py::module::import("numpy").attr("broadcast_arrays")(c1, c2, p, z);
+    input_array c1b(arrays[0]), c2b(arrays[1]), pb(arrays[2]), zb(arrays[3]);
+    std::vector<ssize_t> shape(zb.shape(), zb.shape() + zb.ndim());
+
+    output_array flux;
+    if (out.is_none()) {
+      flux = output_array(shape);
+    } else {
+      if (!py::isinstance<output_array>(out))
+        throw std::invalid_argument("'out' must be a C contiguous array of float32 or float64");
+      flux = py::reinterpret_borrow<output_array>(out);
+      if (!flux.writeable())
+        throw std::invalid_argument("'out' must be writeable");
+      if (flux.ndim() != zb.ndim() || !std::equal(shape.begin(), shape.end(), flux.shape()))
+        throw std::invalid_argument("'out' must have the broadcast shape of the inputs");
+    }
+
+    const T *c1_data = c1b.data(), *c2_data = c2b.data(), *p_data = pb.data(), *z_data = zb.data();
+    T* flux_data = flux.mutable_data();
+    const batman::kernel_table<T>& kernels = batman::kernels<T>();
+    {
+      py::gil_scoped_release release;
+      batman::parallel_for(zb.size(), num_threads, kQuadBatchGrain,
+                           [=](std::int64_t begin, std::int64_t end) {
+        kernels.quad_batch(begin, end, 1, c1_data, c2_data, p_data, z_data, flux_data);
+      });
+    }
+    return flux;
+  }
+
+  // The flux and its partial derivatives with respect to each of the
+  // broadcast (c1, c2, p, z), using the same closed form gradients as
+  // QuadRev. Like quad_batch this runs without the GIL on num_threads
+  // threads.
+  template <typename T>
+  py::tuple quad_value_and_grad (py::object c1, py::object c2, py::object p, py::object z,
+                                 int num_threads) {
+    typedef py::array_t<T, py::array::c_style | py::array::forcecast> input_array;
+
+    py::tuple arrays = py::module::import("numpy").attr("broadcast_arrays")(c1, c2, p, z);
+    input_array c1b(arrays[0]), c2b(arrays[1]), pb(arrays[2]), zb(arrays[3]);
+    std::vector<ssize_t> shape(zb.shape(), zb.shape() + zb.ndim());
+    py::array_t<T> flux(shape), dc1(shape), dc2(shape), dp(shape), dz(shape);
+
+    const T *c1_data = c1b.data(), *c2_data = c2b.data(), *p_data = pb.data(), *z_data = zb.data();
+    T *flux_data = flux.mutable_data(), *dc1_data = dc1.mutable_data(), *dc2_data = dc2.mutable_data(),
+      *dp_data = dp.mutable_data(), *dz_data = dz.mutable_data();
+    const batman::kernel_table<T>& kernels = batman::kernels<T>();
+    {
+      py::gil_scoped_release release;
+      batman::parallel_for(zb.size(), num_threads, kQuadGradGrain,
+                           [=](std::int64_t begin, std::int64_t end) {
+        kernels.quad_grad(begin, end, 1, c1_data, c2_data, p_data, z_data,
+                          flux_data, dc1_data, dc2_data, dp_data, dz_data);
+      });
+    }
+    return py::make_tuple(flux, dc1, dc2, dp, dz);
+  }
+
+}
+
 PYBIND11_MODULE(quad, m) {
   m.def("quad", py::vectorize(batman::quad<double>));
+
+  // The multithreaded version of quad. The precision is that of out if it
+  // is given and otherwise float32 if all of the inputs are float32 and
+  // float64 if not. num_threads <= 0 uses all of the hardware threads.
+  m.def("quad_batch", [](py::object c1, py::object c2, py::object p, py::object z,
+                         py::object out, int num_threads) {
+    py::object dtype;
+    if (out.is_none()) {
+      dtype = py::module::import("numpy").attr("result_type")(c1, c2, p, z);
+    } else {
+      if (!py::isinstance<py::array>(out))
+        throw std::invalid_argument("'out' must be a numpy array");
+      dtype = py::reinterpret_borrow<py::array>(out).dtype();
+    }
+    if (dtype.equal(py::dtype::of<float>()))
+      return quad_batch<float>(c1, c2, p, z, out, num_threads);
+    return quad_batch<double>(c1, c2, p, z, out, num_threads);
+  }, py::arg("c1"), py::arg("c2"), py::arg("p"), py::arg("z"),
+     py::arg("out") = py::none(), py::arg("num_threads") = 0);
+
+  // Returns (flux, dflux/dc1, dflux/dc2, dflux/dp, dflux/dz), all with the
+  // broadcast shape of the inputs; the partials of parameters that were
+  // broadcast need to be summed by the caller. The precision is float32 if
+  // all of the inputs are float32 and float64 otherwise.
+  m.def("quad_value_and_grad", [](py::object c1, py::object c2, py::object p, py::object z,
+                                  int num_threads) {
+    py::object dtype = py::module::import("numpy").attr("result_type")(c1, c2, p, z);
+    if (dtype.equal(py::dtype::of<float>()))
+      return quad_value_and_grad<float>(c1, c2, p, z, num_threads);
+    return quad_value_and_grad<double>(c1, c2, p, z, num_threads);
+  }, py::arg("c1"), py::arg("c2"), py::arg("p"), py::arg("z"), py::arg("num_threads") = 0);
+
+  // The basis functions (lambdae, lambdad, etad) for broadcast (p, z); these
+  // only need to be computed once per geometry and can then be combined with
+  // any number of limb darkening coefficients using quad_combine.
+  m.def("quad_basis", [](py::array_t<double> p, py::array_t<double> z) {
+    py::tuple arrays = py::module::import("numpy").attr("broadcast_arrays")(p, z);
+    auto pb = py::array_t<double, py::array::c_style | py::array::forcecast>(arrays[0]);
+    auto zb = py::array_t<double, py::array::c_style | py::array::forcecast>(arrays[1]);
+    std::vector<ssize_t> shape(zb.shape(), zb.shape() + zb.ndim());
+    py::array_t<double> lambdae(shape), lambdad(shape), etad(shape);
+    batman::quad_basis_batch<double>(0, zb.size(), 1, pb.data(), zb.data(),
+                                     lambdae.mutable_data(), lambdad.mutable_data(), etad.mutable_data());
+    return py::make_tuple(lambdae, lambdad, etad);
+  });
+  m.def("quad_combine", py::vectorize(batman::quad_combine<double>));
+
+  typedef batman::QuadTable<double> QuadTable;
+  py::class_<QuadTable>(m, "QuadTable")
+    .def(py::init<double, double, int, int>(),
+         py::arg("p_min") = 0.005, py::arg("p_max") = 0.3,
+         py::arg("n_p") = 128, py::arg("n_z") = 256)
+    .def_property_readonly("p_min", &QuadTable::p_min)
+    .def_property_readonly("p_max", &QuadTable::p_max)
+    .def_property_readonly("max_error", &QuadTable::max_error)
+    .def("__call__", [](const QuadTable& self, py::array_t<double> c1, py::array_t<double> c2,
+                        py::array_t<double> p, py::array_t<double> z) {
+      return py::vectorize([&self](double c1, double c2, double p, double z) {
+        return self(c1, c2, p, z);
+      })(c1, c2, p, z);
+    });
 }
@@ -11,109 +11,218 @@ namespace batman {
   using std::abs;
   using std::max;
   using std::min;
-
+  using std::pow;
+  using std::sqrt;
+  using std::acos;
+
+  // The geometric configurations handled by quad. Only the partial
+  // occultations need the complete elliptic integrals.
+  enum {
+    QUAD_UNOCCULTED = 0,  // source is unocculted
+    QUAD_OCCULTED,        // source is completely occulted
+    QUAD_EDGE_INNER,      // edge of the occultor at the origin, d == p < 0.5
+    QUAD_EDGE_OUTER,      // edge of the occultor at the origin, d == p > 0.5
+    QUAD_EDGE_HALF,       // edge of the occultor at the origin, d == p == 0.5
+    QUAD_LIMB,            // partly occulted and crossing the limb
+    QUAD_INSIDE,          // transiting inside the disk
+    QUAD_OTHER            // anything else (e.g. non-finite input)
+  };
+
+  // The separation after folding negative impact parameters and snapping to
+  // the corner cases.
   template <typename T>
-  T quad (const T& c1, const T& c2, const T& p, const T& d0) {
-    const T omega = 1.0 - c1/3.0 - c2/6.0;
+  T quad_separation (const T& p, const T& d0) {
+    typedef typename scalar_type<T>::type S;
     const T tol = std::numeric_limits<T>::epsilon();
 
-    T kap0 = T(0.0), kap1 = T(0.0);
-    T lambdad = T(0.0), lambdae = T(0.0), etad = T(0.0);
-
     // allow for negative impact parameters
     T d = abs(d0);
 
     // check the corner cases
     if (abs(p - d) < tol) d = p;
-    if (abs(p - 1.0 - d) < tol) d = p - 1.0;
-    if (abs(1.0 - p - d) < tol) d = 1.0 - p;
+    if (abs(p - S(1.0) - d) < tol) d = p - S(1.0);
+    if (abs(S(1.0) - p - d) < tol) d = S(1.0) - p;
     if (d < tol) d = T(0.0);
 
+    return d;
+  }
+
+  template <typename T>
+  int quad_regime (const T& p, const T& d) {
+    typedef typename scalar_type<T>::type S;
+    if (d >= S(1.0) + p) return QUAD_UNOCCULTED;
+    if (p >= S(1.0) && d <= p - S(1.0)) return QUAD_OCCULTED;
+    if (d == p) {
+      if (d < S(0.5)) return QUAD_EDGE_INNER;
+      if (d > S(0.5)) return QUAD_EDGE_OUTER;
+      return QUAD_EDGE_HALF;
+    }
+    if ((d > S(0.5) + abs(p  - S(0.5)) && d < S(1.0) + p) || (p > S(0.5) && d > abs(S(1.0) - p) && d < p))
+      return QUAD_LIMB;
+    if (p <= S(1.0)  && d <= (S(1.0) - p)) return QUAD_INSIDE;
+    return QUAD_OTHER;
+  }
+
+  // The arguments of the complete elliptic integrals needed by a regime. The
+  // return value is the number of integrals: 0, 2 for K(k) and E(k), or 3 for
+  // K(k), E(k) and Pi(n, k).
+  template <typename T>
+  int quad_ellint_args (int regime, const T& p, const T& d, T& k, T& n) {
+    typedef typename scalar_type<T>::type S;
+    switch (regime) {
+      case QUAD_EDGE_INNER:
+        k = S(2.0)*p;
+        return 2;
+      case QUAD_EDGE_OUTER:
+        k = S(0.5)/p;
+        return 2;
+      case QUAD_LIMB:
+        {
+          T x1 = pow((p - d), S(2.0));
+          k = sqrt((S(1.0) - x1)/S(4.0)/d/p);
+          n = -(S(1.0)/x1 - S(1.0));
+        }
+        return 3;
+      case QUAD_INSIDE:
+        {
+          T x1 = pow((p - d), S(2.0));
+          T x2 = pow((p + d), S(2.0));
+          k = sqrt((x2 - x1)/(S(1.0) - x1));
+          n = -(x2/x1 - S(1.0));
+        }
+        return 3;
+    }
+    return 0;
+  }
+
+  // The basis functions lambdae, lambdad and etad for a given regime given
+  // the complete elliptic integrals at the arguments from quad_ellint_args.
+  // In the fully occulted regime lambdad includes the constant 2/3.
+  template <typename T>
+  void quad_basis_eval (int regime, const T& p, const T& d,
+                        const T& Kk, const T& Ek, const T& Pk,
+                        T& lambdae, T& lambdad, T& etad) {
+    typedef typename scalar_type<T>::type S;
+    const T tol = std::numeric_limits<T>::epsilon();
+
+    T kap0 = T(0.0), kap1 = T(0.0);
+    lambdad = T(0.0);
+    lambdae = T(0.0);
+    etad = T(0.0);
+
     //source is unocculted:
-    if (d >= 1.0 + p) return T(1.0);
+    if (regime == QUAD_UNOCCULTED) return;
 
     //source is completely occulted:
-    if (p >= 1.0 && d <= p - 1.0) {
-      lambdad = T(0.0);
+    if (regime == QUAD_OCCULTED) {
+      lambdad = T(2.0/3.0);
       etad = T(0.5);        //error in Fortran code corrected here, following Jason Eastman's python code
       lambdae = T(1.0);
-      return 1.0 - ((1.0 - c1 - 2.0*c2)*lambdae + (c1 + 2.0*c2)*(lambdad + 2.0/3.0) + c2*etad)/omega;
+      return;
     }
 
-    T x1 = pow((p - d), 2.0);
-    T x2 = pow((p + d), 2.0);
+    T x1 = pow((p - d), S(2.0));
+    T x2 = pow((p + d), S(2.0));
     T x3 = p*p - d*d;
 
     //source is partly occulted and occulting object crosses the limb:
-    if (d >= abs(1.0 - p) && d <= 1.0 + p) {
-      kap1 = acos(min((1.0 - p*p + d*d)/2.0/d, 1.0));
-      kap0 = acos(min((p*p + d*d - 1.0)/2.0/p/d, 1.0));
+    if (d >= abs(S(1.0) - p) && d <= S(1.0) + p) {
+      kap1 = acos(min((S(1.0) - p*p + d*d)/S(2.0)/d, S(1.0)));
+      kap0 = acos(max(min((p*p + d*d - S(1.0))/S(2.0)/p/d, S(1.0)), -S(1.0)));
       lambdae = p*p*kap0 + kap1;
-      lambdae = (lambdae - 0.5*sqrt(max(4.0*d*d - pow((1.0 + d*d - p*p), 2.0), 0.0)))/M_PI;
+      lambdae = (lambdae - S(0.5)*sqrt(max(S(4.0)*d*d - pow((S(1.0) + d*d - p*p), S(2.0)), S(0.0))))/S(M_PI);
     }
 
-    //edge of the occulting star lies at the origin
-    if(d == p) {
-      if(d < 0.5) {
-        T q = 2.0*p;
-        T Kk = ellint_1(q);
-        T Ek = ellint_2(q);
-        lambdad = 1.0/3.0 + 2.0/9.0/M_PI*(4.0*(2.0*p*p - 1.0)*Ek + (1.0 - 4.0*p*p)*Kk);
-        etad = p*p/2.0*(p*p + 2.0*d*d);
-        return 1.0 - ((1.0 - c1 - 2.0*c2)*lambdae + (c1 + 2.0*c2)*lambdad + c2*etad)/omega;
-      } else if(d > 0.5) {
-        T q = 0.5/p;
-        T Kk = ellint_1(q);
-        T Ek = ellint_2(q);
-        lambdad = 1.0/3.0 + 16.0*p/9.0/M_PI*(2.0*p*p - 1.0)*Ek -  \
-                  (32.0*pow(p, 4.0) - 20.0*p*p + 3.0)/9.0/M_PI/p*Kk;
-        etad = 1.0/2.0/M_PI*(kap1 + p*p*(p*p + 2.0*d*d)*kap0 -  \
-            (1.0 + 5.0*p*p + d*d)/4.0*sqrt((1.0 - x1)*(x2 - 1.0)));
-      } else {
+    switch (regime) {
+      //edge of the occulting star lies at the origin
+      case QUAD_EDGE_INNER:
+        lambdae = p*p;
+        lambdad = S(1.0)/S(3.0) + S(2.0)/S(9.0)/S(M_PI)*(S(4.0)*(S(2.0)*p*p - S(1.0))*Ek + (S(1.0) - S(4.0)*p*p)*Kk);
+        etad = p*p/S(2.0)*(p*p + S(2.0)*d*d);
+        break;
+
+      case QUAD_EDGE_OUTER:
+        lambdad = S(1.0)/S(3.0) + S(16.0)*p/S(9.0)/S(M_PI)*(S(2.0)*p*p - S(1.0))*Ek -  \
+                  (S(32.0)*pow(p, S(4.0)) - S(20.0)*p*p + S(3.0))/S(9.0)/S(M_PI)/p*Kk;
+        etad = S(1.0)/S(2.0)/S(M_PI)*(kap1 + p*p*(p*p + S(2.0)*d*d)*kap0 -  \
+            (S(1.0) + S(5.0)*p*p + d*d)/S(4.0)*sqrt((S(1.0) - x1)*(x2 - S(1.0))));
+        break;
+
+      case QUAD_EDGE_HALF:
         lambdad = T(1.0/3.0 - 4.0/M_PI/9.0);
         etad = T(3.0/32.0);
-        return 1.0 - ((1.0 - c1 - 2.0*c2)*lambdae + (c1 + 2.0*c2)*lambdad + c2*etad)/omega;
-      }
-
-      return 1.0 - ((1.0 - c1 - 2.0*c2)*lambdae + (c1 + 2.0*c2)*lambdad + c2*etad)/omega;
+        break;
+
+      //occulting star partly occults the source and crosses the limb:
+      //if((d > 0.5 + abs(p  - 0.5) && d < 1.0 + p) || (p > 0.5 && d > abs(1.0 - p)*1.0001
+      //&& d < p))  //the factor of 1.0001 is from the Mandel/Agol Fortran routine, but gave bad output for d near abs(1-p)
+      case QUAD_LIMB:
+        lambdad = S(1.0)/S(9.0)/S(M_PI)/sqrt(p*d)*(((S(1.0) - x2)*(S(2.0)*x2 + x1 - S(3.0)) - S(3.0)*x3*(x2 - S(2.0)))*Kk + S(4.0)*p*d*(d*d + S(7.0)*p*p - S(4.0))*Ek - S(3.0)*x3/x1*Pk);
+        if(d < p) lambdad += T(2.0/3.0);
+        etad = S(1.0)/S(2.0)/S(M_PI)*(kap1 + p*p*(p*p + S(2.0)*d*d)*kap0 - (S(1.0) + S(5.0)*p*p + d*d)/S(4.0)*sqrt((S(1.0) - x1)*(x2 - S(1.0))));
+        break;
+
+      //occulting star transits the source:
+      case QUAD_INSIDE:
+        etad = p*p/S(2.0)*(p*p + S(2.0)*d*d);
+        lambdae = p*p;
+
+        lambdad = S(2.0)/S(9.0)/S(M_PI)/sqrt(S(1.0) - x1)*((S(1.0) - S(5.0)*d*d + p*p + x3*x3)*Kk + (S(1.0) - x1)*(d*d + S(7.0)*p*p - S(4.0))*Ek - S(3.0)*x3/x1*Pk);
+
+        // edge of planet hits edge of star
+        if(abs(p + d - S(1.0)) <= tol) {
+          lambdad = S(2.0)/S(3.0)/S(M_PI)*acos(S(1.0) - S(2.0)*p) - S(4.0)/S(9.0)/S(M_PI)*sqrt(p*(S(1.0) - p))*(S(3.0) + S(2.0)*p - S(8.0)*p*p);
+        }
+        if(d < p) lambdad += T(2.0/3.0);
+        break;
     }
+  }
 
-    //occulting star partly occults the source and crosses the limb:
-    //if((d > 0.5 + abs(p  - 0.5) && d < 1.0 + p) || (p > 0.5 && d > abs(1.0 - p)*1.0001 \
-    //&& d < p))  //the factor of 1.0001 is from the Mandel/Agol Fortran routine, but gave bad output for d near abs(1-p)
-    if ((d > 0.5 + abs(p  - 0.5) && d < 1.0 + p) || (p > 0.5 && d > abs(1.0 - p) && d < p)) {
-      T q = sqrt((1.0 - x1)/4.0/d/p);
-      T Kk = ellint_1(q);
-      T Ek = ellint_2(q);
-      T n = 1.0/x1 - 1.0;
-      T Pk = ellint_3(T(-n), q);
-      lambdad = 1.0/9.0/M_PI/sqrt(p*d)*(((1.0 - x2)*(2.0*x2 + x1 - 3.0) - 3.0*x3*(x2 - 2.0))*Kk + 4.0*p*d*(d*d + 7.0*p*p - 4.0)*Ek - 3.0*x3/x1*Pk);
-      if(d < p) lambdad += T(2.0/3.0);
-      etad = 1.0/2.0/M_PI*(kap1 + p*p*(p*p + 2.0*d*d)*kap0 - (1.0 + 5.0*p*p + d*d)/4.0*sqrt((1.0 - x1)*(x2 - 1.0)));
-      return 1.0 - ((1.0 - c1 - 2.0*c2)*lambdae + (c1 + 2.0*c2)*lambdad + c2*etad)/omega;
-    }
+  // The flux given the basis functions
+  template <typename T>
+  T quad_combine (const T& c1, const T& c2, const T& lambdae, const T& lambdad, const T& etad) {
+    typedef typename scalar_type<T>::type S;
+    const T omega = S(1.0) - c1/S(3.0) - c2/S(6.0);
+    return S(1.0) - ((S(1.0) - c1 - S(2.0)*c2)*lambdae + (c1 + S(2.0)*c2)*lambdad + c2*etad)/omega;
+  }
 
-    //occulting star transits the source:
-    if (p <= 1.0  && d <= (1.0 - p)) {
-      etad = p*p/2.0*(p*p + 2.0*d*d);
-      lambdae = p*p;
+  // The flux for a given regime given the complete elliptic integrals at the
+  // arguments from quad_ellint_args.
+  template <typename T>
+  T quad_flux (int regime, const T& c1, const T& c2, const T& p, const T& d,
+               const T& Kk, const T& Ek, const T& Pk) {
+    if (regime == QUAD_UNOCCULTED) return T(1.0);
+    T lambdae, lambdad, etad;
+    quad_basis_eval(regime, p, d, Kk, Ek, Pk, lambdae, lambdad, etad);
+    return quad_combine(c1, c2, lambdae, lambdad, etad);
+  }
 
-      T q = sqrt((x2 - x1)/(1.0 - x1));
-      T Kk = ellint_1(q);
-      T Ek = ellint_2(q);
-      T n = x2/x1 - 1.0;
-      T Pk = ellint_3(T(-n), q);
 
-      lambdad = 2.0/9.0/M_PI/sqrt(1.0 - x1)*((1.0 - 5.0*d*d + p*p + x3*x3)*Kk + (1.0 - x1)*(d*d + 7.0*p*p - 4.0)*Ek - 3.0*x3/x1*Pk);
+  template <typename T>
+  T quad (const T& c1, const T& c2, const T& p, const T& d0) {
+    T d = quad_separation(p, d0);
+    int regime = quad_regime(p, d);
 
-      // edge of planet hits edge of star
-      if(abs(p + d - 1.0) <= tol) {
-        lambdad = 2.0/3.0/M_PI*acos(1.0 - 2.0*p) - 4.0/9.0/M_PI*sqrt(p*(1.0 - p))*(3.0 + 2.0*p - 8.0*p*p);
-      }
-      if(d < p) lambdad += T(2.0/3.0);
-    }
+    T k = T(0.0), n = T(0.0), Kk = T(0.0), Ek = T(0.0), Pk = T(0.0);
+    int nint = quad_ellint_args(regime, p, d, k, n);
+    if (nint == 2) ellint_12(k, Kk, Ek);
+    if (nint == 3) ellint_123(n, k, Kk, Ek, Pk);
+
+    return quad_flux(regime, c1, c2, p, d, Kk, Ek, Pk);
+  }
+
+  // The basis functions at (p, d0); see quad_basis_eval
+  template <typename T>
+  void quad_basis (const T& p, const T& d0, T& lambdae, T& lambdad, T& etad) {
+    T d = quad_separation(p, d0);
+    int regime = quad_regime(p, d);
+
+    T k = T(0.0), n = T(0.0), Kk = T(0.0), Ek = T(0.0), Pk = T(0.0);
+    int nint = quad_ellint_args(regime, p, d, k, n);
+    if (nint == 2) ellint_12(k, Kk, Ek);
+    if (nint == 3) ellint_123(n, k, Kk, Ek, Pk);
 
-    return 1.0 - ((1.0 - c1 - 2.0*c2)*lambdae + (c1 + 2.0*c2)*lambdad + c2*etad)/omega;
+    quad_basis_eval(regime, p, d, Kk, Ek, Pk, lambdae, lambdad, etad);
   }
 
 }
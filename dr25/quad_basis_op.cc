@@ -0,0 +1,82 @@
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+#include "kernels.h"
+
+using namespace tensorflow;
+
+// Rough cost (in cycles) of the basis functions for one element; this is
+// all of the cost of batman::quad.
+static const int64 kQuadBasisCostPerElement = 1000;
+
+REGISTER_OP("QuadBasis")
+  .Attr("T: {float, double}")
+  .Input("p: T")
+  .Input("z: T")
+  .Output("lambdae: T")
+  .Output("lambdad: T")
+  .Output("etad: T")
+  .SetShapeFn([](shape_inference::InferenceContext* c) {
+    shape_inference::DimensionHandle d;
+    TF_RETURN_IF_ERROR(c->Merge(c->Dim(c->input(0), 0), c->Dim(c->input(1), 0), &d));
+    for (int k = 0; k < 3; ++k) c->set_output(k, c->input(1));
+    return Status::OK();
+  });
+
+template <typename T>
+class QuadBasisOp : public OpKernel {
+ public:
+  explicit QuadBasisOp(OpKernelConstruction* context) : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    // Inputs
+    const Tensor& p_tensor = context->input(0);
+    const Tensor& z_tensor = context->input(1);
+
+    // Dimensions
+    int64 N = p_tensor.NumElements();
+    int64 M = 1;
+    if (z_tensor.dims() > p_tensor.dims()) {
+      OP_REQUIRES(context, (z_tensor.dims() == p_tensor.dims() + 1), errors::InvalidArgument("invalid dimensions"));
+      M = z_tensor.dim_size(z_tensor.dims() - 1);
+    }
+    OP_REQUIRES(context, (z_tensor.NumElements() == N * M), errors::InvalidArgument("all inputs must have matching shapes"));
+
+    // Outputs
+    Tensor* lambdae_tensor = NULL;
+    Tensor* lambdad_tensor = NULL;
+    Tensor* etad_tensor = NULL;
+    OP_REQUIRES_OK(context, context->allocate_output(0, z_tensor.shape(), &lambdae_tensor));
+    OP_REQUIRES_OK(context, context->allocate_output(1, z_tensor.shape(), &lambdad_tensor));
+    OP_REQUIRES_OK(context, context->allocate_output(2, z_tensor.shape(), &etad_tensor));
+
+    // Access the data
+    const auto p = p_tensor.template flat<T>();
+    const auto z = z_tensor.template flat<T>();
+    auto lambdae = lambdae_tensor->template flat<T>();
+    auto lambdad = lambdad_tensor->template flat<T>();
+    auto etad = etad_tensor->template flat<T>();
+
+    const batman::kernel_table<T>& kernels = batman::kernels<T>();
+    auto work = [&](int64 begin, int64 end) {
+      kernels.quad_basis_batch(begin, end, M, p.data(), z.data(),
+                               lambdae.data(), lambdad.data(), etad.data());
+    };
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+    Shard(worker_threads.num_threads, worker_threads.workers, N * M,
+          kQuadBasisCostPerElement, work);
+  }
+};
+
+
+#define REGISTER_KERNEL(type)                                                 \
+  REGISTER_KERNEL_BUILDER(                                                    \
+      Name("QuadBasis").Device(DEVICE_CPU).TypeConstraint<type>("T"),         \
+      QuadBasisOp<type>)
+
+REGISTER_KERNEL(float);
+REGISTER_KERNEL(double);
+
+#undef REGISTER_KERNEL
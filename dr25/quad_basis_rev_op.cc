@@ -0,0 +1,115 @@
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+#include <algorithm>
+
+#include "quad_grad.h"
+#include "reduce.h"
+
+using namespace tensorflow;
+
+// Rough cost (in cycles) of the basis functions and their derivatives for
+// one element
+static const int64 kQuadBasisRevCostPerElement = 1500;
+
+// The block size for the reduction over the last axis; see
+// batman::blocked_sum
+static const int64 kQuadBasisRevBlockSize = 256;
+
+REGISTER_OP("QuadBasisRev")
+  .Attr("T: {float, double}")
+  .Input("p: T")
+  .Input("z: T")
+  .Input("blambdae: T")
+  .Input("blambdad: T")
+  .Input("betad: T")
+  .Output("bp: T")
+  .Output("bz: T")
+  .SetShapeFn([](shape_inference::InferenceContext* c) {
+    shape_inference::ShapeHandle z;
+    shape_inference::DimensionHandle d;
+    TF_RETURN_IF_ERROR(c->Merge(c->Dim(c->input(0), 0), c->Dim(c->input(1), 0), &d));
+    TF_RETURN_IF_ERROR(c->Merge(c->input(1), c->input(2), &z));
+    TF_RETURN_IF_ERROR(c->Merge(z, c->input(3), &z));
+    TF_RETURN_IF_ERROR(c->Merge(z, c->input(4), &z));
+    c->set_output(0, c->input(0));
+    c->set_output(1, z);
+    return Status::OK();
+  });
+
+template <typename T>
+class QuadBasisRevOp : public OpKernel {
+ public:
+  explicit QuadBasisRevOp(OpKernelConstruction* context) : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    // Inputs
+    const Tensor& p_tensor = context->input(0);
+    const Tensor& z_tensor = context->input(1);
+    const Tensor& ble_tensor = context->input(2);
+    const Tensor& bld_tensor = context->input(3);
+    const Tensor& bed_tensor = context->input(4);
+
+    // Dimensions
+    const int64 N = p_tensor.NumElements();
+    int64 M = 1;
+    if (z_tensor.dims() > p_tensor.dims()) {
+      OP_REQUIRES(context, (z_tensor.dims() == p_tensor.dims() + 1), errors::InvalidArgument("invalid dimensions"));
+      M = z_tensor.dim_size(z_tensor.dims() - 1);
+    }
+    OP_REQUIRES(context, (z_tensor.NumElements() == N * M), errors::InvalidArgument("all inputs must have matching shapes"));
+    OP_REQUIRES(context, (ble_tensor.NumElements() == N * M), errors::InvalidArgument("all inputs must have matching shapes"));
+    OP_REQUIRES(context, (bld_tensor.NumElements() == N * M), errors::InvalidArgument("all inputs must have matching shapes"));
+    OP_REQUIRES(context, (bed_tensor.NumElements() == N * M), errors::InvalidArgument("all inputs must have matching shapes"));
+
+    // Outputs
+    Tensor* bp_tensor = NULL;
+    Tensor* bz_tensor = NULL;
+    OP_REQUIRES_OK(context, context->allocate_output(0, p_tensor.shape(), &bp_tensor));
+    OP_REQUIRES_OK(context, context->allocate_output(1, z_tensor.shape(), &bz_tensor));
+
+    // Access the data
+    const auto p = p_tensor.template flat<T>();
+    const auto z = z_tensor.template flat<T>();
+    const auto ble = ble_tensor.template flat<T>();
+    const auto bld = bld_tensor.template flat<T>();
+    const auto bed = bed_tensor.template flat<T>();
+    auto bp = bp_tensor->template flat<T>();
+    auto bz = bz_tensor->template flat<T>();
+
+    // The per-star sums of the gradient with respect to p
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+    auto shard = [&](int64 units, int64 cost, const std::function<void(int64, int64)>& work) {
+      Shard(worker_threads.num_threads, worker_threads.workers, units, cost, work);
+    };
+    Tensor partial_tensor;
+    OP_REQUIRES_OK(context, context->allocate_temp(DataTypeToEnum<T>::value,
+                                                   TensorShape({N, batman::blocked_sum_blocks(M, kQuadBasisRevBlockSize)}),
+                                                   &partial_tensor));
+    auto block = [&](int64 n, int64 begin, int64 end, T* sum) {
+      T le, le_p, le_z, ld, ld_p, ld_z, ed, ed_p, ed_z;
+      for (int64 m = begin; m < end; ++m) {
+        int64 i = n * M + m;
+        batman::quad_basis_grad<T>(p(n), z(i), le, le_p, le_z, ld, ld_p, ld_z, ed, ed_p, ed_z);
+        sum[0] += ble(i) * le_p + bld(i) * ld_p + bed(i) * ed_p;
+        bz(i) = ble(i) * le_z + bld(i) * ld_z + bed(i) * ed_z;
+      }
+    };
+    batman::blocked_sum<1>(N, M, kQuadBasisRevBlockSize, partial_tensor.template flat<T>().data(), shard,
+                           kQuadBasisRevCostPerElement, block,
+                           [&](int, int64 n, T value) { bp(n) = value; });
+  }
+};
+
+
+#define REGISTER_KERNEL(type)                                                 \
+  REGISTER_KERNEL_BUILDER(                                                    \
+      Name("QuadBasisRev").Device(DEVICE_CPU).TypeConstraint<type>("T"),      \
+      QuadBasisRevOp<type>)
+
+REGISTER_KERNEL(float);
+REGISTER_KERNEL(double);
+
+#undef REGISTER_KERNEL
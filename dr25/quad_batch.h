@@ -0,0 +1,103 @@
+#ifndef _DR25_QUAD_BATCH_H_
+#define _DR25_QUAD_BATCH_H_
+
+#include <cstdint>
+#include <algorithm>
+#include "quad.h"
+#include "ellint_batch.h"
+
+namespace batman {
+
+#define QUAD_BATCH_SIZE 256
+
+  namespace detail {
+
+    // The geometry and elliptic integrals for one chunk of elements
+    template <typename T>
+    struct quad_chunk {
+      int regime[QUAD_BATCH_SIZE], idx2[QUAD_BATCH_SIZE], idx3[QUAD_BATCH_SIZE];
+      T d[QUAD_BATCH_SIZE], Kk[QUAD_BATCH_SIZE], Ek[QUAD_BATCH_SIZE], Pk[QUAD_BATCH_SIZE];
+      T k2[QUAD_BATCH_SIZE], K2[QUAD_BATCH_SIZE], E2[QUAD_BATCH_SIZE];
+      T k3[QUAD_BATCH_SIZE], n3[QUAD_BATCH_SIZE], K3[QUAD_BATCH_SIZE], E3[QUAD_BATCH_SIZE], P3[QUAD_BATCH_SIZE];
+
+      // Classify the elements [chunk, chunk + size) and evaluate the
+      // elliptic integrals for all of them together
+      void compute (std::int64_t chunk, int size, std::int64_t M, const T* p, const T* z) {
+        // Classify and collect the arguments of the elliptic integrals
+        int num2 = 0, num3 = 0;
+        for (int j = 0; j < size; ++j) {
+          std::int64_t i = chunk + j, n = i / M;
+          T k = T(0.0), nu = T(0.0);
+          d[j] = quad_separation(p[n], z[i]);
+          regime[j] = quad_regime(p[n], d[j]);
+          int nint = quad_ellint_args(regime[j], p[n], d[j], k, nu);
+          Kk[j] = Ek[j] = Pk[j] = T(0.0);
+          if (nint == 2) {
+            idx2[num2] = j;
+            k2[num2++] = k;
+          }
+          if (nint == 3) {
+            idx3[num3] = j;
+            k3[num3] = k;
+            n3[num3++] = nu;
+          }
+        }
+
+        // Evaluate the integrals across lanes
+        ellint_12_batch(num2, k2, K2, E2);
+        ellint_123_batch(num3, n3, k3, K3, E3, P3);
+        for (int j = 0; j < num2; ++j) {
+          Kk[idx2[j]] = K2[j];
+          Ek[idx2[j]] = E2[j];
+        }
+        for (int j = 0; j < num3; ++j) {
+          Kk[idx3[j]] = K3[j];
+          Ek[idx3[j]] = E3[j];
+          Pk[idx3[j]] = P3[j];
+        }
+      }
+    };
+
+  }
+
+  // Evaluate quad for the flattened elements [begin, end) of an (N, M) grid
+  // of separations z; the parameters c1, c2 and p are indexed by i / M. The
+  // elements are processed in chunks: the geometry is classified first, the
+  // elliptic integrals for the whole chunk are then evaluated together with
+  // the batch routines and finally the flux is assembled per element.
+  template <typename T>
+  void quad_batch (std::int64_t begin, std::int64_t end, std::int64_t M,
+                   const T* c1, const T* c2, const T* p, const T* z, T* flux) {
+    detail::quad_chunk<T> work;
+    for (std::int64_t chunk = begin; chunk < end; chunk += QUAD_BATCH_SIZE) {
+      int size = int(std::min<std::int64_t>(QUAD_BATCH_SIZE, end - chunk));
+      work.compute(chunk, size, M, p, z);
+      for (int j = 0; j < size; ++j) {
+        std::int64_t i = chunk + j, n = i / M;
+        flux[i] = quad_flux(work.regime[j], c1[n], c2[n], p[n], work.d[j],
+                            work.Kk[j], work.Ek[j], work.Pk[j]);
+      }
+    }
+  }
+
+  // The basis functions (see quad_basis) for the same layout as quad_batch
+  template <typename T>
+  void quad_basis_batch (std::int64_t begin, std::int64_t end, std::int64_t M,
+                         const T* p, const T* z, T* lambdae, T* lambdad, T* etad) {
+    detail::quad_chunk<T> work;
+    for (std::int64_t chunk = begin; chunk < end; chunk += QUAD_BATCH_SIZE) {
+      int size = int(std::min<std::int64_t>(QUAD_BATCH_SIZE, end - chunk));
+      work.compute(chunk, size, M, p, z);
+      for (int j = 0; j < size; ++j) {
+        std::int64_t i = chunk + j, n = i / M;
+        quad_basis_eval(work.regime[j], p[n], work.d[j], work.Kk[j], work.Ek[j], work.Pk[j],
+                        lambdae[i], lambdad[i], etad[i]);
+      }
+    }
+  }
+
+#undef QUAD_BATCH_SIZE
+
+}
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef _DR25_QUAD_BUCKET_H_
+#define _DR25_QUAD_BUCKET_H_
+
+#include <cstdint>
+#include <algorithm>
+#include "quad.h"
+#include "ellint_batch.h"
+
+namespace batman {
+
+#define QUAD_BUCKET_SIZE 512
+#define QUAD_NUM_REGIMES 8
+
+  namespace detail {
+
+    // The flux for num elements that are all in the regime R. R is a
+    // compile time constant so the regime switches in quad_ellint_args and
+    // quad_flux fold away and each loop runs straight-line code.
+    template <int R, typename T>
+    void quad_bucket_kernel (int num, const T* c1, const T* c2, const T* p, const T* d,
+                             T* k, T* n, T* Kk, T* Ek, T* Pk, T* flux) {
+      int nint = 0;
+      for (int j = 0; j < num; ++j) {
+        k[j] = n[j] = Kk[j] = Ek[j] = Pk[j] = T(0.0);
+        nint = quad_ellint_args(R, p[j], d[j], k[j], n[j]);
+      }
+      if (nint == 2) ellint_12_batch(num, k, Kk, Ek);
+      if (nint == 3) ellint_123_batch(num, n, k, Kk, Ek, Pk);
+      for (int j = 0; j < num; ++j)
+        flux[j] = quad_flux(R, c1[j], c2[j], p[j], d[j], Kk[j], Ek[j], Pk[j]);
+    }
+
+    // Scratch space for one chunk; everything lives in fixed size arrays so
+    // nothing is allocated while evaluating.
+    template <typename T>
+    struct quad_buckets {
+      int regime[QUAD_BUCKET_SIZE], order[QUAD_BUCKET_SIZE];
+      int offset[QUAD_NUM_REGIMES + 1];
+      T d[QUAD_BUCKET_SIZE];
+      T c1s[QUAD_BUCKET_SIZE], c2s[QUAD_BUCKET_SIZE], ps[QUAD_BUCKET_SIZE], ds[QUAD_BUCKET_SIZE];
+      T k[QUAD_BUCKET_SIZE], n[QUAD_BUCKET_SIZE];
+      T Kk[QUAD_BUCKET_SIZE], Ek[QUAD_BUCKET_SIZE], Pk[QUAD_BUCKET_SIZE], out[QUAD_BUCKET_SIZE];
+
+      template <int R>
+      void run () {
+        int start = offset[R], num = offset[R + 1] - start;
+        if (num == 0) return;
+        quad_bucket_kernel<R>(num, c1s + start, c2s + start, ps + start, ds + start,
+                              k, n, Kk, Ek, Pk, out + start);
+      }
+
+      void evaluate (std::int64_t chunk, int size, std::int64_t M,
+                     const T* c1, const T* c2, const T* p, const T* z, T* flux) {
+        // Classify and count the elements in each regime
+        int count[QUAD_NUM_REGIMES] = {0};
+        for (int j = 0; j < size; ++j) {
+          std::int64_t i = chunk + j, m = i / M;
+          d[j] = quad_separation(p[m], z[i]);
+          regime[j] = quad_regime(p[m], d[j]);
+          count[regime[j]]++;
+        }
+
+        // Counting sort of the indices by regime, gathering the inputs
+        offset[0] = 0;
+        for (int r = 0; r < QUAD_NUM_REGIMES; ++r) offset[r + 1] = offset[r] + count[r];
+        int fill[QUAD_NUM_REGIMES];
+        std::copy(offset, offset + QUAD_NUM_REGIMES, fill);
+        for (int j = 0; j < size; ++j) {
+          std::int64_t m = (chunk + j) / M;
+          int pos = fill[regime[j]]++;
+          order[pos] = j;
+          c1s[pos] = c1[m];
+          c2s[pos] = c2[m];
+          ps[pos] = p[m];
+          ds[pos] = d[j];
+        }
+
+        // Out of transit is the common case and needs no work at all
+        std::fill(out + offset[QUAD_UNOCCULTED], out + offset[QUAD_UNOCCULTED + 1], T(1.0));
+        run<QUAD_OCCULTED>();
+        run<QUAD_EDGE_INNER>();
+        run<QUAD_EDGE_OUTER>();
+        run<QUAD_EDGE_HALF>();
+        run<QUAD_LIMB>();
+        run<QUAD_INSIDE>();
+        run<QUAD_OTHER>();
+
+        // Scatter back
+        for (int j = 0; j < size; ++j) flux[chunk + order[j]] = out[j];
+      }
+    };
+
+  }
+
+  // The same as quad_batch but each chunk is partitioned by regime before
+  // evaluating so that every kernel only sees one geometry. The results
+  // agree with quad_batch up to rounding (the compiler is free to contract
+  // the specialized kernels into FMAs differently).
+  template <typename T>
+  void quad_bucketed (std::int64_t begin, std::int64_t end, std::int64_t M,
+                      const T* c1, const T* c2, const T* p, const T* z, T* flux) {
+    detail::quad_buckets<T> work;
+    for (std::int64_t chunk = begin; chunk < end; chunk += QUAD_BUCKET_SIZE) {
+      int size = int(std::min<std::int64_t>(QUAD_BUCKET_SIZE, end - chunk));
+      work.evaluate(chunk, size, M, c1, c2, p, z, flux);
+    }
+  }
+
+#undef QUAD_BUCKET_SIZE
+#undef QUAD_NUM_REGIMES
+
+}
+
+#endif
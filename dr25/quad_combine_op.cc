@@ -0,0 +1,116 @@
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+#include "quad.h"
+
+using namespace tensorflow;
+
+// Rough cost (in cycles) of one call to batman::quad_combine
+static const int64 kQuadCombineCostPerElement = 20;
+
+// The flux for every pair of limb darkening coefficients (g1, g2) and every
+// set of basis functions from QuadBasis. The first batch_dims dimensions of
+// the coefficients and the basis functions are shared (e.g. the stars) and
+// the rest are combined as an outer product, so the output has the batch
+// shape followed by the rest of the shape of g1 and then the rest of the
+// shape of the basis functions. For example, (S, K) coefficients and an
+// (S, M) basis give an (S, K, M) flux with batch_dims = 1.
+REGISTER_OP("QuadCombine")
+  .Attr("T: {float, double}")
+  .Attr("batch_dims: int >= 0 = 0")
+  .Input("g1: T")
+  .Input("g2: T")
+  .Input("lambdae: T")
+  .Input("lambdad: T")
+  .Input("etad: T")
+  .Output("flux: T")
+  .SetShapeFn([](shape_inference::InferenceContext* c) {
+    int batch_dims;
+    TF_RETURN_IF_ERROR(c->GetAttr("batch_dims", &batch_dims));
+    shape_inference::ShapeHandle g, b, batch, g_rest, b_rest, out;
+    TF_RETURN_IF_ERROR(c->Merge(c->input(0), c->input(1), &g));
+    TF_RETURN_IF_ERROR(c->Merge(c->input(2), c->input(3), &b));
+    TF_RETURN_IF_ERROR(c->Merge(b, c->input(4), &b));
+    TF_RETURN_IF_ERROR(c->WithRankAtLeast(g, batch_dims, &g));
+    TF_RETURN_IF_ERROR(c->WithRankAtLeast(b, batch_dims, &b));
+    TF_RETURN_IF_ERROR(c->Subshape(g, 0, batch_dims, &batch));
+    TF_RETURN_IF_ERROR(c->Subshape(b, 0, batch_dims, &out));
+    TF_RETURN_IF_ERROR(c->Merge(batch, out, &batch));
+    TF_RETURN_IF_ERROR(c->Subshape(g, batch_dims, &g_rest));
+    TF_RETURN_IF_ERROR(c->Subshape(b, batch_dims, &b_rest));
+    TF_RETURN_IF_ERROR(c->Concatenate(batch, g_rest, &out));
+    TF_RETURN_IF_ERROR(c->Concatenate(out, b_rest, &out));
+    c->set_output(0, out);
+    return Status::OK();
+  });
+
+template <typename T>
+class QuadCombineOp : public OpKernel {
+ public:
+  explicit QuadCombineOp(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("batch_dims", &batch_dims_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    // Inputs
+    const Tensor& g1_tensor = context->input(0);
+    const Tensor& g2_tensor = context->input(1);
+    const Tensor& le_tensor = context->input(2);
+    const Tensor& ld_tensor = context->input(3);
+    const Tensor& ed_tensor = context->input(4);
+
+    // Dimensions
+    OP_REQUIRES(context, (g2_tensor.shape() == g1_tensor.shape()), errors::InvalidArgument("g1 and g2 must have matching shapes"));
+    OP_REQUIRES(context, (ld_tensor.shape() == le_tensor.shape()), errors::InvalidArgument("the basis functions must have matching shapes"));
+    OP_REQUIRES(context, (ed_tensor.shape() == le_tensor.shape()), errors::InvalidArgument("the basis functions must have matching shapes"));
+    OP_REQUIRES(context, (g1_tensor.dims() >= batch_dims_ && le_tensor.dims() >= batch_dims_), errors::InvalidArgument("the inputs must have at least batch_dims dimensions"));
+    TensorShape shape;
+    int64 B = 1;
+    for (int d = 0; d < batch_dims_; ++d) {
+      OP_REQUIRES(context, (g1_tensor.dim_size(d) == le_tensor.dim_size(d)), errors::InvalidArgument("the batch dimensions must match"));
+      shape.AddDim(g1_tensor.dim_size(d));
+      B *= g1_tensor.dim_size(d);
+    }
+    for (int d = batch_dims_; d < g1_tensor.dims(); ++d) shape.AddDim(g1_tensor.dim_size(d));
+    for (int d = batch_dims_; d < le_tensor.dims(); ++d) shape.AddDim(le_tensor.dim_size(d));
+    const int64 K = B > 0 ? g1_tensor.NumElements() / B : 0;
+    const int64 N = B > 0 ? le_tensor.NumElements() / B : 0;
+
+    // Output
+    Tensor* flux_tensor = NULL;
+    OP_REQUIRES_OK(context, context->allocate_output(0, shape, &flux_tensor));
+
+    // Access the data
+    const auto g1 = g1_tensor.template flat<T>();
+    const auto g2 = g2_tensor.template flat<T>();
+    const auto le = le_tensor.template flat<T>();
+    const auto ld = ld_tensor.template flat<T>();
+    const auto ed = ed_tensor.template flat<T>();
+    auto flux = flux_tensor->template flat<T>();
+
+    auto work = [&](int64 begin, int64 end) {
+      for (int64 i = begin; i < end; ++i) {
+        int64 b = i / (K * N), k = b * K + (i / N) % K, n = b * N + i % N;
+        flux(i) = batman::quad_combine<T>(g1(k), g2(k), le(n), ld(n), ed(n));
+      }
+    };
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+    Shard(worker_threads.num_threads, worker_threads.workers, B * K * N,
+          kQuadCombineCostPerElement, work);
+  }
+ private:
+  int batch_dims_;
+};
+
+
+#define REGISTER_KERNEL(type)                                                 \
+  REGISTER_KERNEL_BUILDER(                                                    \
+      Name("QuadCombine").Device(DEVICE_CPU).TypeConstraint<type>("T"),       \
+      QuadCombineOp<type>)
+
+REGISTER_KERNEL(float);
+REGISTER_KERNEL(double);
+
+#undef REGISTER_KERNEL
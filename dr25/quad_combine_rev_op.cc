@@ -0,0 +1,150 @@
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+#include "quad_grad.h"
+
+using namespace tensorflow;
+
+// Rough cost (in cycles) of one call to batman::quad_combine_grad
+static const int64 kQuadCombineRevCostPerElement = 40;
+
+REGISTER_OP("QuadCombineRev")
+  .Attr("T: {float, double}")
+  .Attr("batch_dims: int >= 0 = 0")
+  .Input("g1: T")
+  .Input("g2: T")
+  .Input("lambdae: T")
+  .Input("lambdad: T")
+  .Input("etad: T")
+  .Input("bflux: T")
+  .Output("bg1: T")
+  .Output("bg2: T")
+  .Output("blambdae: T")
+  .Output("blambdad: T")
+  .Output("betad: T")
+  .SetShapeFn([](shape_inference::InferenceContext* c) {
+    shape_inference::ShapeHandle g, b;
+    TF_RETURN_IF_ERROR(c->Merge(c->input(0), c->input(1), &g));
+    TF_RETURN_IF_ERROR(c->Merge(c->input(2), c->input(3), &b));
+    TF_RETURN_IF_ERROR(c->Merge(b, c->input(4), &b));
+    c->set_output(0, g);
+    c->set_output(1, g);
+    c->set_output(2, b);
+    c->set_output(3, b);
+    c->set_output(4, b);
+    return Status::OK();
+  });
+
+template <typename T>
+class QuadCombineRevOp : public OpKernel {
+ public:
+  explicit QuadCombineRevOp(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("batch_dims", &batch_dims_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    // Inputs
+    const Tensor& g1_tensor = context->input(0);
+    const Tensor& g2_tensor = context->input(1);
+    const Tensor& le_tensor = context->input(2);
+    const Tensor& ld_tensor = context->input(3);
+    const Tensor& ed_tensor = context->input(4);
+    const Tensor& bflux_tensor = context->input(5);
+
+    // Dimensions
+    OP_REQUIRES(context, (g2_tensor.shape() == g1_tensor.shape()), errors::InvalidArgument("g1 and g2 must have matching shapes"));
+    OP_REQUIRES(context, (ld_tensor.shape() == le_tensor.shape()), errors::InvalidArgument("the basis functions must have matching shapes"));
+    OP_REQUIRES(context, (ed_tensor.shape() == le_tensor.shape()), errors::InvalidArgument("the basis functions must have matching shapes"));
+    OP_REQUIRES(context, (g1_tensor.dims() >= batch_dims_ && le_tensor.dims() >= batch_dims_), errors::InvalidArgument("the inputs must have at least batch_dims dimensions"));
+    int64 B = 1;
+    for (int d = 0; d < batch_dims_; ++d) {
+      OP_REQUIRES(context, (g1_tensor.dim_size(d) == le_tensor.dim_size(d)), errors::InvalidArgument("the batch dimensions must match"));
+      B *= g1_tensor.dim_size(d);
+    }
+    const int64 K = B > 0 ? g1_tensor.NumElements() / B : 0;
+    const int64 N = B > 0 ? le_tensor.NumElements() / B : 0;
+    OP_REQUIRES(context, (bflux_tensor.NumElements() == B * K * N), errors::InvalidArgument("bflux must have the shape of the output"));
+
+    // Outputs
+    Tensor* bg1_tensor = NULL;
+    Tensor* bg2_tensor = NULL;
+    Tensor* ble_tensor = NULL;
+    Tensor* bld_tensor = NULL;
+    Tensor* bed_tensor = NULL;
+    OP_REQUIRES_OK(context, context->allocate_output(0, g1_tensor.shape(), &bg1_tensor));
+    OP_REQUIRES_OK(context, context->allocate_output(1, g2_tensor.shape(), &bg2_tensor));
+    OP_REQUIRES_OK(context, context->allocate_output(2, le_tensor.shape(), &ble_tensor));
+    OP_REQUIRES_OK(context, context->allocate_output(3, ld_tensor.shape(), &bld_tensor));
+    OP_REQUIRES_OK(context, context->allocate_output(4, ed_tensor.shape(), &bed_tensor));
+
+    // Access the data
+    const auto g1 = g1_tensor.template flat<T>();
+    const auto g2 = g2_tensor.template flat<T>();
+    const auto le = le_tensor.template flat<T>();
+    const auto ld = ld_tensor.template flat<T>();
+    const auto ed = ed_tensor.template flat<T>();
+    const auto bflux = bflux_tensor.template flat<T>();
+    auto bg1 = bg1_tensor->template flat<T>();
+    auto bg2 = bg2_tensor->template flat<T>();
+    auto ble = ble_tensor->template flat<T>();
+    auto bld = bld_tensor->template flat<T>();
+    auto bed = bed_tensor->template flat<T>();
+
+    // Each output is owned by exactly one shard and summed in a fixed order
+    // so the result does not depend on the number of threads. The partials
+    // are cheap enough that evaluating them twice beats sharing scratch.
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+
+    // The coefficients: sum over the basis functions in the same batch.
+    // The element (b, k, n) of the flux is at (b * K + k) * N + n.
+    auto work_g = [&](int64 begin, int64 end) {
+      for (int64 k = begin; k < end; ++k) {
+        T sg1 = T(0.0), sg2 = T(0.0), dg1, dg2, dle, dld, ded;
+        const int64 b = k / K;
+        for (int64 n = b * N; n < (b + 1) * N; ++n) {
+          batman::quad_combine_grad<T>(g1(k), g2(k), le(n), ld(n), ed(n), dg1, dg2, dle, dld, ded);
+          sg1 += bflux(k * N + n - b * N) * dg1;
+          sg2 += bflux(k * N + n - b * N) * dg2;
+        }
+        bg1(k) = sg1;
+        bg2(k) = sg2;
+      }
+    };
+    Shard(worker_threads.num_threads, worker_threads.workers, B * K,
+          N * kQuadCombineRevCostPerElement, work_g);
+
+    // The basis functions: sum over the coefficients in the same batch
+    auto work_b = [&](int64 begin, int64 end) {
+      for (int64 n = begin; n < end; ++n) {
+        T sle = T(0.0), sld = T(0.0), sed = T(0.0), dg1, dg2, dle, dld, ded;
+        const int64 b = n / N;
+        for (int64 k = b * K; k < (b + 1) * K; ++k) {
+          batman::quad_combine_grad<T>(g1(k), g2(k), le(n), ld(n), ed(n), dg1, dg2, dle, dld, ded);
+          sle += bflux(k * N + n - b * N) * dle;
+          sld += bflux(k * N + n - b * N) * dld;
+          sed += bflux(k * N + n - b * N) * ded;
+        }
+        ble(n) = sle;
+        bld(n) = sld;
+        bed(n) = sed;
+      }
+    };
+    Shard(worker_threads.num_threads, worker_threads.workers, B * N,
+          K * kQuadCombineRevCostPerElement, work_b);
+  }
+ private:
+  int batch_dims_;
+};
+
+
+#define REGISTER_KERNEL(type)                                                 \
+  REGISTER_KERNEL_BUILDER(                                                    \
+      Name("QuadCombineRev").Device(DEVICE_CPU).TypeConstraint<type>("T"),    \
+      QuadCombineRevOp<type>)
+
+REGISTER_KERNEL(float);
+REGISTER_KERNEL(double);
+
+#undef REGISTER_KERNEL
@@ -0,0 +1,304 @@
+#ifndef _DR25_QUAD_GRAD_H_
+#define _DR25_QUAD_GRAD_H_
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "ellint.h"
+#include "quad.h"
+
+namespace batman {
+
+  using std::abs;
+  using std::max;
+  using std::min;
+
+  // Closed form partial derivatives of the quadratic limb darkening model.
+  //
+  // The basis functions lambdae, lambdad and etad only depend on (p, d) and
+  // their derivatives are computed by hand for each regime in quad_basis_grad.
+  // The flux is linear in them so the derivatives with respect to c1 and c2
+  // follow directly. The corner case snapping in quad_separation is treated
+  // like AutoDiff would treat it: when d is replaced by p, p - 1 or 1 - p it
+  // inherits the dependence on p and loses the dependence on z.
+
+  // The basis functions and their derivatives with respect to p and d
+  template <typename T>
+  void quad_basis_grad (int regime, const T& p, const T& d,
+                        T& lambdae, T& lambdae_p, T& lambdae_d,
+                        T& lambdad, T& lambdad_p, T& lambdad_d,
+                        T& etad, T& etad_p, T& etad_d) {
+    typedef typename scalar_type<T>::type S;
+    const T tol = std::numeric_limits<T>::epsilon();
+
+    lambdae = lambdae_p = lambdae_d = T(0.0);
+    lambdad = lambdad_p = lambdad_d = T(0.0);
+    etad = etad_p = etad_d = T(0.0);
+
+    if (regime == QUAD_UNOCCULTED) return;
+
+    if (regime == QUAD_OCCULTED) {
+      lambdae = T(1.0);
+      lambdad = T(2.0/3.0);
+      etad = T(0.5);
+      return;
+    }
+
+    T x1 = (p - d)*(p - d), x1_p = S(2.0)*(p - d), x1_d = -x1_p;
+    T x2 = (p + d)*(p + d), x2_p = S(2.0)*(p + d), x2_d = x2_p;
+    T x3 = p*p - d*d, x3_p = S(2.0)*p, x3_d = -S(2.0)*d;
+
+    //source is partly occulted and occulting object crosses the limb:
+    T kap0 = T(0.0), kap0_p = T(0.0), kap0_d = T(0.0);
+    T kap1 = T(0.0), kap1_p = T(0.0), kap1_d = T(0.0);
+    if (d >= abs(S(1.0) - p) && d <= S(1.0) + p) {
+      T u1 = (S(1.0) - p*p + d*d)/S(2.0)/d;
+      if (u1 < S(1.0)) {
+        T f = -S(1.0) / sqrt(S(1.0) - u1*u1);
+        kap1 = acos(u1);
+        kap1_p = f * (-p/d);
+        kap1_d = f * (d*d + p*p - S(1.0))/(S(2.0)*d*d);
+      }
+      T u0 = (p*p + d*d - S(1.0))/S(2.0)/p/d;
+      if (u0 <= -S(1.0)) {
+        kap0 = T(M_PI);
+      } else if (u0 < S(1.0)) {
+        T f = -S(1.0) / sqrt(S(1.0) - u0*u0);
+        kap0 = acos(u0);
+        kap0_p = f * (p*p - d*d + S(1.0))/(S(2.0)*p*p*d);
+        kap0_d = f * (d*d - p*p + S(1.0))/(S(2.0)*p*d*d);
+      }
+      T e = S(1.0) + d*d - p*p;
+      T q = S(4.0)*d*d - e*e, sq = T(0.0), sq_p = T(0.0), sq_d = T(0.0);
+      if (q > S(0.0)) {
+        sq = sqrt(q);
+        sq_p = S(4.0)*p*e / (S(2.0)*sq);
+        sq_d = (S(8.0)*d - S(4.0)*d*e) / (S(2.0)*sq);
+      }
+      lambdae = (p*p*kap0 + kap1 - S(0.5)*sq)*S(1.0/M_PI);
+      lambdae_p = (S(2.0)*p*kap0 + p*p*kap0_p + kap1_p - S(0.5)*sq_p)*S(1.0/M_PI);
+      lambdae_d = (p*p*kap0_d + kap1_d - S(0.5)*sq_d)*S(1.0/M_PI);
+    }
+
+    // The etad expression shared by the limb crossing regimes
+    T b = p*p*(p*p + S(2.0)*d*d), b_p = S(4.0)*p*p*p + S(4.0)*p*d*d, b_d = S(4.0)*p*p*d;
+    if (regime == QUAD_EDGE_OUTER || regime == QUAD_LIMB) {
+      T w = (S(1.0) - x1)*(x2 - S(1.0));
+      T sw = sqrt(w), sw_p = T(0.0), sw_d = T(0.0);
+      if (w > S(0.0)) {
+        sw_p = (-x1_p*(x2 - S(1.0)) + (S(1.0) - x1)*x2_p) / (S(2.0)*sw);
+        sw_d = (-x1_d*(x2 - S(1.0)) + (S(1.0) - x1)*x2_d) / (S(2.0)*sw);
+      }
+      T c = (S(1.0) + S(5.0)*p*p + d*d)/S(4.0), c_p = S(2.5)*p, c_d = S(0.5)*d;
+      etad = S(0.5/M_PI)*(kap1 + b*kap0 - c*sw);
+      etad_p = S(0.5/M_PI)*(kap1_p + b_p*kap0 + b*kap0_p - c_p*sw - c*sw_p);
+      etad_d = S(0.5/M_PI)*(kap1_d + b_d*kap0 + b*kap0_d - c_d*sw - c*sw_d);
+    }
+
+    T k, k_p, k_d, n, n_p, n_d, Kk, Ek, Pk, dK_dk, dE_dk, dP_dn, dP_dk;
+
+    switch (regime) {
+      //edge of the occulting star lies at the origin
+      case QUAD_EDGE_INNER:
+        k = S(2.0)*p;
+        ellint_12(k, Kk, Ek);
+        ellint_123_grad(T(0.5), k, Kk, Ek, T(0.0), dK_dk, dE_dk, dP_dn, dP_dk);
+        lambdad = S(1.0/3.0) + S(2.0/9.0/M_PI)*(S(4.0)*(S(2.0)*p*p - S(1.0))*Ek + (S(1.0) - S(4.0)*p*p)*Kk);
+        lambdad_p = S(2.0/9.0/M_PI)*(S(16.0)*p*Ek + S(8.0)*(S(2.0)*p*p - S(1.0))*dE_dk
+                                  - S(8.0)*p*Kk + S(2.0)*(S(1.0) - S(4.0)*p*p)*dK_dk);
+        etad = S(0.5)*b;
+        etad_p = S(0.5)*b_p;
+        etad_d = S(0.5)*b_d;
+        lambdae = p*p;
+        lambdae_p = S(2.0)*p;
+        break;
+
+      case QUAD_EDGE_OUTER:
+        {
+          k = S(0.5)/p;
+          k_p = -S(0.5)/(p*p);
+          ellint_12(k, Kk, Ek);
+          ellint_123_grad(T(0.5), k, Kk, Ek, T(0.0), dK_dk, dE_dk, dP_dn, dP_dk);
+          T a = S(16.0/9.0/M_PI)*p*(S(2.0)*p*p - S(1.0)), a_p = S(16.0/9.0/M_PI)*(S(6.0)*p*p - S(1.0));
+          T c = (S(32.0)*p*p*p*p - S(20.0)*p*p + S(3.0))*S(1.0/9.0/M_PI)/p,
+            c_p = (S(96.0)*p*p - S(20.0) - S(3.0)/(p*p))*S(1.0/9.0/M_PI);
+          lambdad = S(1.0/3.0) + a*Ek - c*Kk;
+          lambdad_p = a_p*Ek + a*dE_dk*k_p - c_p*Kk - c*dK_dk*k_p;
+        }
+        break;
+
+      case QUAD_EDGE_HALF:
+        lambdad = T(1.0/3.0 - 4.0/M_PI/9.0);
+        etad = T(3.0/32.0);
+        break;
+
+      case QUAD_LIMB:
+        {
+          T k2 = (S(1.0) - x1)/(S(4.0)*d*p);
+          k = sqrt(k2);
+          k_p = (-x1_p/(S(4.0)*p*d) - (S(1.0) - x1)/(S(4.0)*p*p*d)) / (S(2.0)*k);
+          k_d = (-x1_d/(S(4.0)*p*d) - (S(1.0) - x1)/(S(4.0)*p*d*d)) / (S(2.0)*k);
+          n = -(S(1.0)/x1 - S(1.0));
+          n_p = x1_p/(x1*x1);
+          n_d = x1_d/(x1*x1);
+          ellint_123(n, k, Kk, Ek, Pk);
+          ellint_123_grad(n, k, Kk, Ek, Pk, dK_dk, dE_dk, dP_dn, dP_dk);
+
+          T aK = (S(1.0) - x2)*(S(2.0)*x2 + x1 - S(3.0)) - S(3.0)*x3*(x2 - S(2.0)),
+            aK_p = -x2_p*(S(2.0)*x2 + x1 - S(3.0)) + (S(1.0) - x2)*(S(2.0)*x2_p + x1_p) - S(3.0)*x3_p*(x2 - S(2.0)) - S(3.0)*x3*x2_p,
+            aK_d = -x2_d*(S(2.0)*x2 + x1 - S(3.0)) + (S(1.0) - x2)*(S(2.0)*x2_d + x1_d) - S(3.0)*x3_d*(x2 - S(2.0)) - S(3.0)*x3*x2_d;
+          T r = d*d + S(7.0)*p*p - S(4.0);
+          T aE = S(4.0)*p*d*r, aE_p = S(4.0)*d*r + S(56.0)*p*p*d, aE_d = S(4.0)*p*r + S(8.0)*p*d*d;
+          T aP = -S(3.0)*x3/x1,
+            aP_p = -S(3.0)*(x3_p*x1 - x3*x1_p)/(x1*x1),
+            aP_d = -S(3.0)*(x3_d*x1 - x3*x1_d)/(x1*x1);
+
+          T g = aK*Kk + aE*Ek + aP*Pk;
+          T g_p = aK_p*Kk + aK*dK_dk*k_p + aE_p*Ek + aE*dE_dk*k_p + aP_p*Pk + aP*(dP_dn*n_p + dP_dk*k_p);
+          T g_d = aK_d*Kk + aK*dK_dk*k_d + aE_d*Ek + aE*dE_dk*k_d + aP_d*Pk + aP*(dP_dn*n_d + dP_dk*k_d);
+          T f = S(1.0/9.0/M_PI)/sqrt(p*d);
+
+          lambdad = f*g;
+          lambdad_p = f*(g_p - S(0.5)*g/p);
+          lambdad_d = f*(g_d - S(0.5)*g/d);
+          if(d < p) lambdad += T(2.0/3.0);
+        }
+        break;
+
+      //occulting star transits the source:
+      case QUAD_INSIDE:
+        etad = S(0.5)*b;
+        etad_p = S(0.5)*b_p;
+        etad_d = S(0.5)*b_d;
+        lambdae = p*p;
+        lambdae_p = S(2.0)*p;
+        lambdae_d = T(0.0);
+
+        // edge of planet hits edge of star
+        if(abs(p + d - S(1.0)) <= tol) {
+          T s = sqrt(p*(S(1.0) - p)), s_p = (S(1.0) - S(2.0)*p)/(S(2.0)*s);
+          T r = S(3.0) + S(2.0)*p - S(8.0)*p*p, r_p = S(2.0) - S(16.0)*p;
+          lambdad = S(2.0/3.0/M_PI)*acos(S(1.0) - S(2.0)*p) - S(4.0/9.0/M_PI)*s*r;
+          lambdad_p = S(2.0/3.0/M_PI)/s - S(4.0/9.0/M_PI)*(s_p*r + s*r_p);
+        } else if (d == S(0.0)) {
+          // centered on the disk: k = n = 0 so the general expressions are
+          // 0/0, but the model is even in d and K = E = Pi = pi/2 give
+          // lambdad = -2/3 (1 - p^2)^(3/2)
+          T s = sqrt(S(1.0) - p*p);
+          lambdad = -S(2.0/3.0)*(S(1.0) - p*p)*s;
+          lambdad_p = S(2.0)*p*s;
+        } else {
+          T k2 = (x2 - x1)/(S(1.0) - x1);
+          k = sqrt(k2);
+          k_p = ((x2_p - x1_p)*(S(1.0) - x1) + (x2 - x1)*x1_p)/((S(1.0) - x1)*(S(1.0) - x1)) / (S(2.0)*k);
+          k_d = ((x2_d - x1_d)*(S(1.0) - x1) + (x2 - x1)*x1_d)/((S(1.0) - x1)*(S(1.0) - x1)) / (S(2.0)*k);
+          n = -(x2/x1 - S(1.0));
+          n_p = -(x2_p*x1 - x2*x1_p)/(x1*x1);
+          n_d = -(x2_d*x1 - x2*x1_d)/(x1*x1);
+          ellint_123(n, k, Kk, Ek, Pk);
+          ellint_123_grad(n, k, Kk, Ek, Pk, dK_dk, dE_dk, dP_dn, dP_dk);
+
+          T aK = S(1.0) - S(5.0)*d*d + p*p + x3*x3,
+            aK_p = S(2.0)*p + S(2.0)*x3*x3_p,
+            aK_d = -S(10.0)*d + S(2.0)*x3*x3_d;
+          T r = d*d + S(7.0)*p*p - S(4.0);
+          T aE = (S(1.0) - x1)*r, aE_p = -x1_p*r + (S(1.0) - x1)*S(14.0)*p, aE_d = -x1_d*r + (S(1.0) - x1)*S(2.0)*d;
+          T aP = -S(3.0)*x3/x1,
+            aP_p = -S(3.0)*(x3_p*x1 - x3*x1_p)/(x1*x1),
+            aP_d = -S(3.0)*(x3_d*x1 - x3*x1_d)/(x1*x1);
+
+          T g = aK*Kk + aE*Ek + aP*Pk;
+          T g_p = aK_p*Kk + aK*dK_dk*k_p + aE_p*Ek + aE*dE_dk*k_p + aP_p*Pk + aP*(dP_dn*n_p + dP_dk*k_p);
+          T g_d = aK_d*Kk + aK*dK_dk*k_d + aE_d*Ek + aE*dE_dk*k_d + aP_d*Pk + aP*(dP_dn*n_d + dP_dk*k_d);
+          T f = S(2.0/9.0/M_PI)/sqrt(S(1.0) - x1);
+
+          lambdad = f*g;
+          lambdad_p = f*(g_p + S(0.5)*g*x1_p/(S(1.0) - x1));
+          lambdad_d = f*(g_d + S(0.5)*g*x1_d/(S(1.0) - x1));
+        }
+        if(d < p) lambdad += T(2.0/3.0);
+        break;
+    }
+  }
+
+  // quad_separation, also returning dd/dp and dd/dd0
+  template <typename T>
+  T quad_separation_grad (const T& p, const T& d0, T& d_p, T& d_d0) {
+    typedef typename scalar_type<T>::type S;
+    const T tol = std::numeric_limits<T>::epsilon();
+    T d = abs(d0);
+    d_p = T(0.0);
+    d_d0 = (d0 < S(0.0)) ? T(-1.0) : T(1.0);
+    if (abs(p - d) < tol) { d = p; d_p = T(1.0); d_d0 = T(0.0); }
+    if (abs(p - S(1.0) - d) < tol) { d = p - S(1.0); d_p = T(1.0); d_d0 = T(0.0); }
+    if (abs(S(1.0) - p - d) < tol) { d = S(1.0) - p; d_p = T(-1.0); d_d0 = T(0.0); }
+    if (d < tol) { d = T(0.0); d_p = T(0.0); d_d0 = T(0.0); }
+    return d;
+  }
+
+  // The basis functions at (p, d0) and their derivatives with respect to p
+  // and d0; see quad_basis
+  template <typename T>
+  void quad_basis_grad (const T& p, const T& d0,
+                        T& lambdae, T& lambdae_p, T& lambdae_d0,
+                        T& lambdad, T& lambdad_p, T& lambdad_d0,
+                        T& etad, T& etad_p, T& etad_d0) {
+    T d_p, d_d0, le_d, ld_d, ed_d;
+    T d = quad_separation_grad(p, d0, d_p, d_d0);
+    quad_basis_grad(quad_regime(p, d), p, d, lambdae, lambdae_p, le_d,
+                    lambdad, lambdad_p, ld_d, etad, etad_p, ed_d);
+    lambdae_p += le_d*d_p;
+    lambdad_p += ld_d*d_p;
+    etad_p += ed_d*d_p;
+    lambdae_d0 = le_d*d_d0;
+    lambdad_d0 = ld_d*d_d0;
+    etad_d0 = ed_d*d_d0;
+  }
+
+  // quad_combine and its partial derivatives with respect to all arguments
+  template <typename T>
+  T quad_combine_grad (const T& c1, const T& c2, const T& lambdae, const T& lambdad, const T& etad,
+                       T& dc1, T& dc2, T& dlambdae, T& dlambdad, T& detad) {
+    typedef typename scalar_type<T>::type S;
+    const T omega = S(1.0) - c1/S(3.0) - c2/S(6.0);
+    const T a = S(1.0) - c1 - S(2.0)*c2, b = c1 + S(2.0)*c2;
+    const T s = a*lambdae + b*lambdad + c2*etad;
+
+    dc1 = -(lambdad - lambdae)/omega - s/(S(3.0)*omega*omega);
+    dc2 = -(S(2.0)*(lambdad - lambdae) + etad)/omega - s/(S(6.0)*omega*omega);
+    dlambdae = -a/omega;
+    dlambdad = -b/omega;
+    detad = -c2/omega;
+
+    return S(1.0) - s/omega;
+  }
+
+  // The flux and its partial derivatives with respect to c1, c2, p and d0
+  template <typename T>
+  T quad_grad (const T& c1, const T& c2, const T& p, const T& d0,
+               T& dc1, T& dc2, T& dp, T& dd0) {
+    T d_p, d_d0;
+    T d = quad_separation_grad(p, d0, d_p, d_d0);
+
+    int regime = quad_regime(p, d);
+    if (regime == QUAD_UNOCCULTED) {
+      dc1 = dc2 = dp = dd0 = T(0.0);
+      return T(1.0);
+    }
+
+    T le, le_p, le_d, ld, ld_p, ld_d, ed, ed_p, ed_d;
+    quad_basis_grad(regime, p, d, le, le_p, le_d, ld, ld_p, ld_d, ed, ed_p, ed_d);
+
+    T dle, dld, ded;
+    T flux = quad_combine_grad(c1, c2, le, ld, ed, dc1, dc2, dle, dld, ded);
+    T fp = dle*le_p + dld*ld_p + ded*ed_p,
+      fd = dle*le_d + dld*ld_d + ded*ed_d;
+    dp = fp + fd*d_p;
+    dd0 = fd*d_d0;
+
+    return flux;
+  }
+
+}
+
+#endif
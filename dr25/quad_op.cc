@@ -1,14 +1,23 @@
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 #include <cmath>
 #include <limits>
 
-#include "quad.h"
+#include "kernels.h"
 
 using namespace tensorflow;
 
+// Rough cost (in cycles) of one call to batman::quad. Elements that are out
+// of transit return after a handful of comparisons, but anything overlapping
+// the disk evaluates up to three Bulirsch iterations (~8 steps each with a
+// sqrt and a division) plus a couple of acos/sqrt calls. We quote the
+// in-transit cost since that is where the time goes and it keeps the shards
+// small enough to balance the mix of regimes.
+static const int64 kQuadCostPerElement = 1000;
+
 REGISTER_OP("Quad")
   .Attr("T: {float, double}")
   .Input("g1: T")
@@ -60,11 +69,19 @@ class QuadOp : public OpKernel {
     const auto z = z_tensor.template flat<T>();
     auto flux = flux_tensor->template flat<T>();
 
-    for (int64 n = 0; n < N; ++n) {
-      for (int64 m = 0; m < M; ++m) {
-        flux(n) = batman::quad<T>(g1(n), g2(n), p(n), z(n * M + m));
-      }
-    }
+    // Every element is independent (the SIMD lanes are masked once they
+    // converge) so sharding over the flattened (N, M) index gives the same
+    // output for any number of threads. The output is not bitwise identical
+    // to batman::quad though: the AVX2 and AVX-512 kernels contract into
+    // FMAs and differ by up to ~3e-14 in double and ~2e-5 in float. The
+    // generic kernels (DR25_ISA=generic) reproduce batman::quad exactly.
+    const batman::kernel_table<T>& kernels = batman::kernels<T>();
+    auto work = [&](int64 begin, int64 end) {
+      kernels.quad_bucketed(begin, end, M, g1.data(), g2.data(), p.data(), z.data(), flux.data());
+    };
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+    Shard(worker_threads.num_threads, worker_threads.workers, N * M,
+          kQuadCostPerElement, work);
   }
 };
 
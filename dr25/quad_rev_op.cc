@@ -1,15 +1,25 @@
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 #include <cmath>
 #include <limits>
+#include <algorithm>
 
-#include "quad.h"
-#include "ellint_grad.h"
+#include "quad_grad.h"
+#include "reduce.h"
 
 using namespace tensorflow;
 
+// Rough cost (in cycles) of one call to batman::quad_grad; the closed form
+// derivatives add about a third to the cost of the forward pass.
+static const int64 kQuadRevCostPerElement = 1500;
+
+// The block size for the per-star reductions over the last axis; see
+// batman::blocked_sum
+static const int64 kQuadRevBlockSize = 256;
+
 REGISTER_OP("QuadRev")
   .Attr("T: {float, double}")
   .Input("g1: T")
@@ -81,26 +91,30 @@ class QuadRevOp : public OpKernel {
     auto bp = bp_tensor->template flat<T>();
     auto bz = bz_tensor->template flat<T>();
 
-    typedef Eigen::Matrix<T, 4, 1> DerType;
-
-    for (int64 n = 0; n < N; ++n) {
-      Eigen::AutoDiffScalar<DerType> ad_g1(g1(n), 4, 0),
-                                     ad_g2(g2(n), 4, 1),
-                                     ad_p(p(n), 4, 2);
-      bg1(n) = 0.0;
-      bg2(n) = 0.0;
-      bp(n) = 0.0;
-      for (int64 m = 0; m < M; ++m) {
+    // The per-star sums of the parameter gradients
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+    auto shard = [&](int64 units, int64 cost, const std::function<void(int64, int64)>& work) {
+      Shard(worker_threads.num_threads, worker_threads.workers, units, cost, work);
+    };
+    Tensor partial_tensor;
+    OP_REQUIRES_OK(context, context->allocate_temp(DataTypeToEnum<T>::value,
+                                                   TensorShape({3, N, batman::blocked_sum_blocks(M, kQuadRevBlockSize)}),
+                                                   &partial_tensor));
+    auto block = [&](int64 n, int64 begin, int64 end, T* sum) {
+      T dg1, dg2, dp, dz;
+      for (int64 m = begin; m < end; ++m) {
         int64 i = n * M + m;
-        Eigen::AutoDiffScalar<DerType> ad_z(z(i), 4, 3);
-        auto f = batman::quad(ad_g1, ad_g2, ad_p, ad_z);
-        auto d = f.derivatives();
-        bg1(n) += bflux(i) * d(0);
-        bg2(n) += bflux(i) * d(1);
-        bp(n) += bflux(i) * d(2);
-        bz(i) = bflux(i) * d(3);
+        batman::quad_grad<T>(g1(n), g2(n), p(n), z(i), dg1, dg2, dp, dz);
+        sum[0] += bflux(i) * dg1;
+        sum[1] += bflux(i) * dg2;
+        sum[2] += bflux(i) * dp;
+        bz(i) = bflux(i) * dz;
       }
-    }
+    };
+    T* outputs[] = {bg1.data(), bg2.data(), bp.data()};
+    batman::blocked_sum<3>(N, M, kQuadRevBlockSize, partial_tensor.template flat<T>().data(), shard,
+                           kQuadRevCostPerElement, block,
+                           [&](int q, int64 n, T value) { outputs[q][n] = value; });
   }
 };
 
@@ -0,0 +1,158 @@
+#ifndef _DR25_QUAD_TABLE_H_
+#define _DR25_QUAD_TABLE_H_
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include "quad.h"
+
+namespace batman {
+
+  // A precomputed table of the basis functions lambdae, lambdad and etad for
+  // planets with p_min <= p <= p_max < 0.5.
+  //
+  // For each p the separations are split into three segments, [0, p],
+  // [p, 1-p] and [1-p, 1+p], at the points where the basis functions are
+  // not smooth, and each segment is sampled at n_z points. The table is
+  // evaluated with tensor product cubic (4 point Lagrange) interpolation in
+  // (p, s) where s is the fractional position in the segment; near the ends
+  // of a segment the stencil is shifted inwards so that it never straddles a
+  // kink. Anything outside of the table (p out of range or d >= 1+p) falls
+  // back to the exact expressions.
+  //
+  // The largest absolute error in any of the basis functions is measured when
+  // the table is built by comparing against the exact values at the quarter
+  // points of every cell and it is available as max_error(). The error in
+  // the flux is then approximately bounded by
+  //
+  //   max_error() * (|1 - c1 - 2*c2| + |c1 + 2*c2| + |c2|) / omega.
+  template <typename T>
+  class QuadTable {
+   public:
+    QuadTable (T p_min, T p_max, int n_p, int n_z)
+      : p_min_(p_min), p_max_(p_max), n_p_(n_p), n_z_(n_z), max_error_(0.0)
+    {
+      if (!(p_min > T(0.0) && p_max > p_min && p_max < T(0.5)))
+        throw std::invalid_argument("the table requires 0 < p_min < p_max < 0.5");
+      if (n_p < 4 || n_z < 4)
+        throw std::invalid_argument("the table needs at least 4 nodes in each dimension");
+
+      dp_ = (p_max_ - p_min_) / (n_p_ - 1);
+      ds_ = T(1.0) / (n_z_ - 1);
+      inv_dp_ = T(1.0) / dp_;
+      table_.resize(size_t(n_p_) * 3 * n_z_ * 3);
+      for (int i = 0; i < n_p_; ++i) {
+        T p = p_min_ + i * dp_;
+        if (i == n_p_ - 1) p = p_max_;
+        for (int seg = 0; seg < 3; ++seg) {
+          T lo, hi;
+          segment(seg, p, lo, hi);
+          for (int j = 0; j < n_z_; ++j) {
+            T* v = &(table_[index(i, seg, j)]);
+            quad_basis(p, lo + (hi - lo) * (j * ds_), v[0], v[1], v[2]);
+          }
+        }
+      }
+
+      // Measure the interpolation error at the quarter points of every cell
+      for (int i = 0; i < 4 * (n_p_ - 1); ++i) {
+        if (i % 4 == 0) continue;
+        T p = p_min_ + T(0.25) * i * dp_;
+        for (int seg = 0; seg < 3; ++seg) {
+          T lo, hi;
+          segment(seg, p, lo, hi);
+          for (int j = 0; j < 4 * (n_z_ - 1); ++j) {
+            if (j % 4 == 0) continue;
+            T s = T(0.25) * j * ds_, exact[3], approx[3];
+            quad_basis(p, lo + (hi - lo) * s, exact[0], exact[1], exact[2]);
+            interp(p, seg, s, approx);
+            for (int k = 0; k < 3; ++k)
+              max_error_ = std::max<T>(max_error_, std::abs(approx[k] - exact[k]));
+          }
+        }
+      }
+    }
+
+    T p_min () const { return p_min_; }
+    T p_max () const { return p_max_; }
+    T max_error () const { return max_error_; }
+
+    // The basis functions at (p, d0). A NaN p or d0 goes to the exact model
+    // as well since the stencil cannot be located for it.
+    void basis (const T& p, const T& d0, T& lambdae, T& lambdad, T& etad) const {
+      T d = std::abs(d0);
+      if (!(p >= p_min_ && p <= p_max_) || !(d < T(1.0) + p)) {
+        quad_basis(p, d0, lambdae, lambdad, etad);
+        return;
+      }
+      int seg = (d < p) ? 0 : ((d < T(1.0) - p) ? 1 : 2);
+      T lo, hi, v[3];
+      segment(seg, p, lo, hi);
+      interp(p, seg, (d - lo) / (hi - lo), v);
+      lambdae = v[0];
+      lambdad = v[1];
+      etad = v[2];
+    }
+
+    T operator() (const T& c1, const T& c2, const T& p, const T& d0) const {
+      T lambdae, lambdad, etad;
+      if (std::abs(d0) >= T(1.0) + p) return T(1.0);
+      basis(p, d0, lambdae, lambdad, etad);
+      return quad_combine(c1, c2, lambdae, lambdad, etad);
+    }
+
+   private:
+    T p_min_, p_max_, dp_, ds_, inv_dp_;
+    int n_p_, n_z_;
+    T max_error_;
+    std::vector<T> table_;
+
+    size_t index (int i, int seg, int j) const {
+      return ((size_t(i) * 3 + seg) * n_z_ + j) * 3;
+    }
+
+    static void segment (int seg, const T& p, T& lo, T& hi) {
+      if (seg == 0) {
+        lo = T(0.0);
+        hi = p;
+      } else if (seg == 1) {
+        lo = p;
+        hi = T(1.0) - p;
+      } else {
+        lo = T(1.0) - p;
+        hi = T(1.0) + p;
+      }
+    }
+
+    // Find the first node of the 4 point stencil around x (in units of the
+    // grid spacing) and compute the Lagrange weights.
+    static int stencil (const T& x, int n, T* w) {
+      int i = int(std::floor(x)) - 1;
+      i = std::max(0, std::min(i, n - 4));
+      T t = x - i;
+      w[0] = -(t - T(1.0)) * (t - T(2.0)) * (t - T(3.0)) * T(1.0/6.0);
+      w[1] = t * (t - T(2.0)) * (t - T(3.0)) * T(0.5);
+      w[2] = -t * (t - T(1.0)) * (t - T(3.0)) * T(0.5);
+      w[3] = t * (t - T(1.0)) * (t - T(2.0)) * T(1.0/6.0);
+      return i;
+    }
+
+    void interp (const T& p, int seg, const T& s, T* v) const {
+      T wp[4], ws[4];
+      int i0 = stencil((p - p_min_) * inv_dp_, n_p_, wp);
+      int j0 = stencil(s * (n_z_ - 1), n_z_, ws);
+      v[0] = v[1] = v[2] = T(0.0);
+      for (int a = 0; a < 4; ++a) {
+        T row[3] = {T(0.0), T(0.0), T(0.0)};
+        const T* node = &(table_[index(i0 + a, seg, j0)]);
+        for (int b = 0; b < 4; ++b)
+          for (int k = 0; k < 3; ++k) row[k] += ws[b] * node[3 * b + k];
+        for (int k = 0; k < 3; ++k) v[k] += wp[a] * row[k];
+      }
+    }
+  };
+
+}
+
+#endif
@@ -0,0 +1,100 @@
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+#include "kernels.h"
+
+using namespace tensorflow;
+
+// Rough cost (in cycles) of one call to batman::quad_grad
+static const int64 kQuadWithGradCostPerElement = 1500;
+
+REGISTER_OP("QuadWithGrad")
+  .Attr("T: {float, double}")
+  .Input("g1: T")
+  .Input("g2: T")
+  .Input("p: T")
+  .Input("z: T")
+  .Output("flux: T")
+  .Output("dg1: T")
+  .Output("dg2: T")
+  .Output("dp: T")
+  .Output("dz: T")
+  .SetShapeFn([](shape_inference::InferenceContext* c) {
+    shape_inference::ShapeHandle s;
+    shape_inference::DimensionHandle d;
+    TF_RETURN_IF_ERROR(c->Merge(c->input(0), c->input(1), &s));
+    TF_RETURN_IF_ERROR(c->Merge(s, c->input(2), &s));
+    TF_RETURN_IF_ERROR(c->Merge(c->Dim(s, 0), c->Dim(c->input(3), 0), &d));
+    for (int k = 0; k < 5; ++k) c->set_output(k, c->input(3));
+    return Status::OK();
+  });
+
+template <typename T>
+class QuadWithGradOp : public OpKernel {
+ public:
+  explicit QuadWithGradOp(OpKernelConstruction* context) : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    // Inputs
+    const Tensor& g1_tensor = context->input(0);
+    const Tensor& g2_tensor = context->input(1);
+    const Tensor& p_tensor = context->input(2);
+    const Tensor& z_tensor = context->input(3);
+
+    // Dimensions
+    int64 N = g1_tensor.NumElements();
+    int64 M = 1;
+    if (z_tensor.dims() > g1_tensor.dims()) {
+      OP_REQUIRES(context, (z_tensor.dims() == g1_tensor.dims() + 1), errors::InvalidArgument("invalid dimensions"));
+      M = z_tensor.dim_size(z_tensor.dims() - 1);
+    }
+    OP_REQUIRES(context, (g2_tensor.NumElements() == N), errors::InvalidArgument("all inputs must have matching shapes"));
+    OP_REQUIRES(context, (p_tensor.NumElements() == N), errors::InvalidArgument("all inputs must have matching shapes"));
+    OP_REQUIRES(context, (z_tensor.NumElements() == N * M), errors::InvalidArgument("all inputs must have matching shapes"));
+
+    // Outputs
+    Tensor* flux_tensor = NULL;
+    Tensor* dg1_tensor = NULL;
+    Tensor* dg2_tensor = NULL;
+    Tensor* dp_tensor = NULL;
+    Tensor* dz_tensor = NULL;
+    OP_REQUIRES_OK(context, context->allocate_output(0, z_tensor.shape(), &flux_tensor));
+    OP_REQUIRES_OK(context, context->allocate_output(1, z_tensor.shape(), &dg1_tensor));
+    OP_REQUIRES_OK(context, context->allocate_output(2, z_tensor.shape(), &dg2_tensor));
+    OP_REQUIRES_OK(context, context->allocate_output(3, z_tensor.shape(), &dp_tensor));
+    OP_REQUIRES_OK(context, context->allocate_output(4, z_tensor.shape(), &dz_tensor));
+
+    // Access the data
+    const auto g1 = g1_tensor.template flat<T>();
+    const auto g2 = g2_tensor.template flat<T>();
+    const auto p = p_tensor.template flat<T>();
+    const auto z = z_tensor.template flat<T>();
+    auto flux = flux_tensor->template flat<T>();
+    auto dg1 = dg1_tensor->template flat<T>();
+    auto dg2 = dg2_tensor->template flat<T>();
+    auto dp = dp_tensor->template flat<T>();
+    auto dz = dz_tensor->template flat<T>();
+
+    const batman::kernel_table<T>& kernels = batman::kernels<T>();
+    auto work = [&](int64 begin, int64 end) {
+      kernels.quad_grad(begin, end, M, g1.data(), g2.data(), p.data(), z.data(),
+                        flux.data(), dg1.data(), dg2.data(), dp.data(), dz.data());
+    };
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+    Shard(worker_threads.num_threads, worker_threads.workers, N * M,
+          kQuadWithGradCostPerElement, work);
+  }
+};
+
+
+#define REGISTER_KERNEL(type)                                                 \
+  REGISTER_KERNEL_BUILDER(                                                    \
+      Name("QuadWithGrad").Device(DEVICE_CPU).TypeConstraint<type>("T"),      \
+      QuadWithGradOp<type>)
+
+REGISTER_KERNEL(float);
+REGISTER_KERNEL(double);
+
+#undef REGISTER_KERNEL
@@ -0,0 +1,74 @@
+#ifndef _DR25_REDUCE_H_
+#define _DR25_REDUCE_H_
+
+#include <cstdint>
+#include <algorithm>
+
+namespace batman {
+
+  // Pairwise summation of x[0], ..., x[n-1]. The order of operations is fixed
+  // by n alone so the result does not depend on how the caller is threaded.
+  template <typename T>
+  T pairwise_sum (const T* x, std::int64_t n) {
+    if (n <= 8) {
+      T result = T(0.0);
+      for (std::int64_t i = 0; i < n; ++i) result += x[i];
+      return result;
+    }
+    std::int64_t half = n / 2;
+    return pairwise_sum(x, half) + pairwise_sum(x + half, n - half);
+  }
+
+  // Deterministic parallel sums of L quantities over each of N rows of M
+  // elements, e.g. the per-star gradients of the parameters that are
+  // broadcast over the time axis.
+  //
+  // Each row is split into fixed blocks of block_size elements. The first
+  // pass sums every block serially, with the blocks spread over the threads,
+  // and the second combines the block sums of each row with pairwise_sum.
+  // The block layout only depends on M and block_size, so the result is
+  // bitwise the same for any number of threads.
+  //
+  //   partial    scratch for L * N * blocked_sum_blocks(M, block_size) sums
+  //   shard      shard(units, cost_per_unit, work) calls work(begin, end)
+  //              over [0, units), typically tensorflow::Shard on the op's
+  //              worker threads
+  //   block      block(n, begin, end, sum) adds the elements [begin, end) of
+  //              row n to sum[0], ..., sum[L-1], which start at zero; it may
+  //              also write per-element outputs
+  //   store      store(q, n, value) receives the sum of quantity q for row n
+  //
+  // The accumulator type A can be wider than the data (ExpectedDetections
+  // sums in double).
+  inline std::int64_t blocked_sum_blocks (std::int64_t M, std::int64_t block_size) {
+    return (M + block_size - 1) / block_size;
+  }
+
+  template <int L, typename A, typename Shard, typename Block, typename Store>
+  void blocked_sum (std::int64_t N, std::int64_t M, std::int64_t block_size, A* partial,
+                    const Shard& shard, std::int64_t cost_per_element,
+                    const Block& block, const Store& store) {
+    const std::int64_t K = blocked_sum_blocks(M, block_size);
+
+    // First pass: sum within each block
+    shard(N * K, block_size * cost_per_element, [&](std::int64_t begin, std::int64_t end) {
+      for (std::int64_t j = begin; j < end; ++j) {
+        std::int64_t n = j / K, k = j % K;
+        A sum[L];
+        std::fill(sum, sum + L, A(0.0));
+        block(n, k * block_size, std::min(M, (k + 1) * block_size), sum);
+        for (int q = 0; q < L; ++q) partial[(q * N + n) * K + k] = sum[q];
+      }
+    });
+
+    // Second pass: combine the blocks for each row
+    shard(N, L * K, [&](std::int64_t begin, std::int64_t end) {
+      for (std::int64_t n = begin; n < end; ++n)
+        for (int q = 0; q < L; ++q)
+          store(q, n, pairwise_sum(partial + (q * N + n) * K, K));
+    });
+  }
+
+}
+
+#endif
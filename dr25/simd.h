@@ -0,0 +1,221 @@
+#ifndef _DR25_SIMD_H_
+#define _DR25_SIMD_H_
+
+#include <cmath>
+
+// The widest instruction set to use: 3 for AVX-512F, 2 for AVX, 1 for SSE2
+// and 0 for none. This follows the compiler flags unless it is defined
+// before including this header, which is needed when the target is set with
+// a pragma because GCC doesn't update the __AVX__ etc. macros in C++ (see
+// kernels_impl.h).
+#ifndef DR25_SIMD_LEVEL
+#if defined(__AVX512F__)
+#define DR25_SIMD_LEVEL 3
+#elif defined(__AVX__)
+#define DR25_SIMD_LEVEL 2
+#elif defined(__SSE2__)
+#define DR25_SIMD_LEVEL 1
+#else
+#define DR25_SIMD_LEVEL 0
+#endif
+#endif
+
+#if DR25_SIMD_LEVEL > 0
+#include <immintrin.h>
+#endif
+
+namespace batman {
+namespace simd {
+
+  // A minimal packet abstraction over the widest instruction set that the
+  // translation unit is compiled for. Each specialization provides:
+  //
+  //   type, mask   the register and comparison mask types,
+  //   size         the number of lanes,
+  //   load/store   unaligned memory access,
+  //   set1         broadcast a scalar,
+  //   add, sub, mul, div, sqrt, abs,
+  //   le           lane-wise a <= b,
+  //   mask_andnot  a & ~b for masks,
+  //   select       (m ? a : b) lane-wise,
+  //   any          true if any lane of the mask is set.
+  //
+  // The generic version is a single scalar lane so that the batch routines
+  // still compile (and give the same answers) without any vector extensions.
+  template <typename T>
+  struct packet {
+    typedef T type;
+    typedef bool mask;
+    static const int size = 1;
+
+    static type load (const T* x) { return *x; }
+    static void store (T* x, const type& a) { *x = a; }
+    static type set1 (const T& x) { return x; }
+    static type add (const type& a, const type& b) { return a + b; }
+    static type sub (const type& a, const type& b) { return a - b; }
+    static type mul (const type& a, const type& b) { return a * b; }
+    static type div (const type& a, const type& b) { return a / b; }
+    static type sqrt (const type& a) { using std::sqrt; return sqrt(a); }
+    static type abs (const type& a) { using std::abs; return abs(a); }
+    static mask le (const type& a, const type& b) { return a <= b; }
+    static mask all_true () { return true; }
+    static mask mask_andnot (const mask& a, const mask& b) { return a && !b; }
+    static type select (const mask& m, const type& a, const type& b) { return m ? a : b; }
+    static bool any (const mask& m) { return m; }
+  };
+
+#if DR25_SIMD_LEVEL >= 3
+
+  template <>
+  struct packet<double> {
+    typedef __m512d type;
+    typedef __mmask8 mask;
+    static const int size = 8;
+
+    static type load (const double* x) { return _mm512_loadu_pd(x); }
+    static void store (double* x, const type& a) { _mm512_storeu_pd(x, a); }
+    static type set1 (const double& x) { return _mm512_set1_pd(x); }
+    static type add (const type& a, const type& b) { return _mm512_add_pd(a, b); }
+    static type sub (const type& a, const type& b) { return _mm512_sub_pd(a, b); }
+    static type mul (const type& a, const type& b) { return _mm512_mul_pd(a, b); }
+    static type div (const type& a, const type& b) { return _mm512_div_pd(a, b); }
+    // _mm512_sqrt_pd passes an undefined vector through GCC's masked builtin,
+    // which -Wall reports as uninitialized; the zero-masked form with every
+    // lane set compiles to the same vsqrtpd
+    static type sqrt (const type& a) { return _mm512_maskz_sqrt_pd(mask(0xff), a); }
+    static type abs (const type& a) {
+      return _mm512_castsi512_pd(_mm512_and_si512(_mm512_castpd_si512(a), _mm512_set1_epi64(0x7fffffffffffffffLL)));
+    }
+    static mask le (const type& a, const type& b) { return _mm512_cmp_pd_mask(a, b, _CMP_LE_OQ); }
+    static mask all_true () { return 0xff; }
+    static mask mask_andnot (const mask& a, const mask& b) { return a & ~b; }
+    static type select (const mask& m, const type& a, const type& b) { return _mm512_mask_blend_pd(m, b, a); }
+    static bool any (const mask& m) { return m != 0; }
+  };
+
+  template <>
+  struct packet<float> {
+    typedef __m512 type;
+    typedef __mmask16 mask;
+    static const int size = 16;
+
+    static type load (const float* x) { return _mm512_loadu_ps(x); }
+    static void store (float* x, const type& a) { _mm512_storeu_ps(x, a); }
+    static type set1 (const float& x) { return _mm512_set1_ps(x); }
+    static type add (const type& a, const type& b) { return _mm512_add_ps(a, b); }
+    static type sub (const type& a, const type& b) { return _mm512_sub_ps(a, b); }
+    static type mul (const type& a, const type& b) { return _mm512_mul_ps(a, b); }
+    static type div (const type& a, const type& b) { return _mm512_div_ps(a, b); }
+    static type sqrt (const type& a) { return _mm512_maskz_sqrt_ps(mask(0xffff), a); }
+    static type abs (const type& a) {
+      return _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(a), _mm512_set1_epi32(0x7fffffff)));
+    }
+    static mask le (const type& a, const type& b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+    static mask all_true () { return 0xffff; }
+    static mask mask_andnot (const mask& a, const mask& b) { return a & ~b; }
+    static type select (const mask& m, const type& a, const type& b) { return _mm512_mask_blend_ps(m, b, a); }
+    static bool any (const mask& m) { return m != 0; }
+  };
+
+#elif DR25_SIMD_LEVEL >= 2
+
+  template <>
+  struct packet<double> {
+    typedef __m256d type;
+    typedef __m256d mask;
+    static const int size = 4;
+
+    static type load (const double* x) { return _mm256_loadu_pd(x); }
+    static void store (double* x, const type& a) { _mm256_storeu_pd(x, a); }
+    static type set1 (const double& x) { return _mm256_set1_pd(x); }
+    static type add (const type& a, const type& b) { return _mm256_add_pd(a, b); }
+    static type sub (const type& a, const type& b) { return _mm256_sub_pd(a, b); }
+    static type mul (const type& a, const type& b) { return _mm256_mul_pd(a, b); }
+    static type div (const type& a, const type& b) { return _mm256_div_pd(a, b); }
+    static type sqrt (const type& a) { return _mm256_sqrt_pd(a); }
+    static type abs (const type& a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+    static mask le (const type& a, const type& b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+    static mask all_true () { return _mm256_castsi256_pd(_mm256_set1_epi64x(-1)); }
+    static mask mask_andnot (const mask& a, const mask& b) { return _mm256_andnot_pd(b, a); }
+    static type select (const mask& m, const type& a, const type& b) { return _mm256_blendv_pd(b, a, m); }
+    static bool any (const mask& m) { return _mm256_movemask_pd(m) != 0; }
+  };
+
+  template <>
+  struct packet<float> {
+    typedef __m256 type;
+    typedef __m256 mask;
+    static const int size = 8;
+
+    static type load (const float* x) { return _mm256_loadu_ps(x); }
+    static void store (float* x, const type& a) { _mm256_storeu_ps(x, a); }
+    static type set1 (const float& x) { return _mm256_set1_ps(x); }
+    static type add (const type& a, const type& b) { return _mm256_add_ps(a, b); }
+    static type sub (const type& a, const type& b) { return _mm256_sub_ps(a, b); }
+    static type mul (const type& a, const type& b) { return _mm256_mul_ps(a, b); }
+    static type div (const type& a, const type& b) { return _mm256_div_ps(a, b); }
+    static type sqrt (const type& a) { return _mm256_sqrt_ps(a); }
+    static type abs (const type& a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    static mask le (const type& a, const type& b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+    static mask all_true () { return _mm256_castsi256_ps(_mm256_set1_epi32(-1)); }
+    static mask mask_andnot (const mask& a, const mask& b) { return _mm256_andnot_ps(b, a); }
+    static type select (const mask& m, const type& a, const type& b) { return _mm256_blendv_ps(b, a, m); }
+    static bool any (const mask& m) { return _mm256_movemask_ps(m) != 0; }
+  };
+
+#elif DR25_SIMD_LEVEL >= 1
+
+  template <>
+  struct packet<double> {
+    typedef __m128d type;
+    typedef __m128d mask;
+    static const int size = 2;
+
+    static type load (const double* x) { return _mm_loadu_pd(x); }
+    static void store (double* x, const type& a) { _mm_storeu_pd(x, a); }
+    static type set1 (const double& x) { return _mm_set1_pd(x); }
+    static type add (const type& a, const type& b) { return _mm_add_pd(a, b); }
+    static type sub (const type& a, const type& b) { return _mm_sub_pd(a, b); }
+    static type mul (const type& a, const type& b) { return _mm_mul_pd(a, b); }
+    static type div (const type& a, const type& b) { return _mm_div_pd(a, b); }
+    static type sqrt (const type& a) { return _mm_sqrt_pd(a); }
+    static type abs (const type& a) { return _mm_andnot_pd(_mm_set1_pd(-0.0), a); }
+    static mask le (const type& a, const type& b) { return _mm_cmple_pd(a, b); }
+    static mask all_true () { return _mm_castsi128_pd(_mm_set1_epi32(-1)); }
+    static mask mask_andnot (const mask& a, const mask& b) { return _mm_andnot_pd(b, a); }
+    static type select (const mask& m, const type& a, const type& b) {
+      return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b));
+    }
+    static bool any (const mask& m) { return _mm_movemask_pd(m) != 0; }
+  };
+
+  template <>
+  struct packet<float> {
+    typedef __m128 type;
+    typedef __m128 mask;
+    static const int size = 4;
+
+    static type load (const float* x) { return _mm_loadu_ps(x); }
+    static void store (float* x, const type& a) { _mm_storeu_ps(x, a); }
+    static type set1 (const float& x) { return _mm_set1_ps(x); }
+    static type add (const type& a, const type& b) { return _mm_add_ps(a, b); }
+    static type sub (const type& a, const type& b) { return _mm_sub_ps(a, b); }
+    static type mul (const type& a, const type& b) { return _mm_mul_ps(a, b); }
+    static type div (const type& a, const type& b) { return _mm_div_ps(a, b); }
+    static type sqrt (const type& a) { return _mm_sqrt_ps(a); }
+    static type abs (const type& a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+    static mask le (const type& a, const type& b) { return _mm_cmple_ps(a, b); }
+    static mask all_true () { return _mm_castsi128_ps(_mm_set1_epi32(-1)); }
+    static mask mask_andnot (const mask& a, const mask& b) { return _mm_andnot_ps(b, a); }
+    static type select (const mask& m, const type& a, const type& b) {
+      return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+    }
+    static bool any (const mask& m) { return _mm_movemask_ps(m) != 0; }
+  };
+
+#endif
+
+}
+}
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef _DR25_SOBOL_H_
+#define _DR25_SOBOL_H_
+
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+namespace batman {
+
+  // Owen-scrambled Sobol points in up to sobol_max_dims dimensions. The
+  // unscrambled point with index i in dimension d is the XOR of the
+  // direction numbers of d selected by the bits of i, so every point can be
+  // computed directly from its index: a thread skips ahead to its own slice
+  // of the sequence for free and nothing is shared between threads. The
+  // scrambling is the hash based nested uniform scramble of Burley (2020)
+  // with the Laine-Karras style permutation, seeded independently in each
+  // dimension, so different seeds give independent randomized QMC
+  // estimates while every prefix of 2^m points keeps the stratification of
+  // the Sobol net.
+  //
+  // The direction numbers are those of Joe & Kuo (2008), new-joe-kuo-6.21201;
+  // the first dimension is the van der Corput sequence.
+
+  const int sobol_max_dims = 16;
+  const int sobol_bits = 32;
+
+  namespace detail {
+
+    // The degree s, the polynomial coefficients a and the initial m_1..m_s
+    // of dimensions 2..16 of new-joe-kuo-6.21201
+    struct SobolPrimitive {
+      int s;
+      std::uint32_t a;
+      std::uint32_t m[6];
+    };
+
+    const SobolPrimitive sobol_primitives[sobol_max_dims - 1] = {
+      {1,  0, {1}},
+      {2,  1, {1, 3}},
+      {3,  1, {1, 3, 1}},
+      {3,  2, {1, 1, 1}},
+      {4,  1, {1, 1, 3, 3}},
+      {4,  4, {1, 3, 5, 13}},
+      {5,  2, {1, 1, 5, 5, 17}},
+      {5,  4, {1, 1, 5, 5, 5}},
+      {5,  7, {1, 1, 7, 11, 19}},
+      {5, 11, {1, 1, 5, 1, 1}},
+      {5, 13, {1, 1, 1, 3, 11}},
+      {5, 14, {1, 3, 5, 5, 31}},
+      {6,  1, {1, 3, 3, 9, 7, 49}},
+      {6, 13, {1, 1, 1, 15, 21, 21}},
+      {6, 16, {1, 3, 1, 13, 27, 49}},
+    };
+
+    inline std::uint32_t sobol_reverse_bits (std::uint32_t x) {
+      x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+      x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+      x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+      x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+      return (x >> 16) | (x << 16);
+    }
+
+    // A permutation of the bit-reversed value in which each bit only depends
+    // on the bits below it, i.e. an Owen scramble of the original value
+    inline std::uint32_t sobol_laine_karras (std::uint32_t x, std::uint32_t seed) {
+      x += seed;
+      x ^= x * 0x6c50b47cu;
+      x ^= x * 0xb82f1e52u;
+      x ^= x * 0xc7afe638u;
+      x ^= x * 0x8d22f6e6u;
+      return x;
+    }
+
+    inline std::uint32_t sobol_hash (std::uint32_t x) {
+      x ^= x >> 16;
+      x *= 0x21f0aaadu;
+      x ^= x >> 15;
+      x *= 0xd35a2d97u;
+      x ^= x >> 15;
+      return x;
+    }
+
+  }
+
+  // The direction numbers (as 32 bit fractions) of the first dims
+  // dimensions, expanded once into lookup tables; sample and uniform are
+  // then cheap and const
+  class SobolSequence {
+   public:
+    SobolSequence (int dims, std::uint64_t seed) : dims_(std::max(1, std::min(dims, sobol_max_dims))) {
+      std::uint32_t v[sobol_max_dims][sobol_bits];
+      for (int b = 0; b < sobol_bits; ++b) v[0][b] = std::uint32_t(1) << (sobol_bits - 1 - b);
+      for (int d = 1; d < dims_; ++d) {
+        const detail::SobolPrimitive& p = detail::sobol_primitives[d - 1];
+        for (int b = 0; b < sobol_bits; ++b) {
+          if (b < p.s) {
+            v[d][b] = p.m[b] << (sobol_bits - 1 - b);
+          } else {
+            std::uint32_t x = v[d][b - p.s] ^ (v[d][b - p.s] >> p.s);
+            for (int k = 1; k < p.s; ++k)
+              if ((p.a >> (p.s - 1 - k)) & 1u) x ^= v[d][b - k];
+            v[d][b] = x;
+          }
+        }
+      }
+
+      // The XOR of the direction numbers for every value of each nibble of
+      // the index, so that a point costs 8 lookups instead of a loop over
+      // the bits
+      for (int d = 0; d < dims_; ++d) {
+        for (int q = 0; q < sobol_bits / 4; ++q) {
+          for (int n = 0; n < 16; ++n) {
+            std::uint32_t x = 0;
+            for (int b = 0; b < 4; ++b)
+              if ((n >> b) & 1) x ^= v[d][4 * q + b];
+            table_[d][q][n] = x;
+          }
+        }
+      }
+
+      const std::uint32_t s = detail::sobol_hash(std::uint32_t(seed) ^ detail::sobol_hash(std::uint32_t(seed >> 32)));
+      for (int d = 0; d < dims_; ++d) seed_[d] = detail::sobol_hash(s + 0x9e3779b9u * std::uint32_t(d + 1));
+    }
+
+    int dims () const { return dims_; }
+
+    // The scrambled point with the given index in dimension d as a 32 bit
+    // fraction. Only the low 32 bits of the index are used, so the
+    // sequence repeats after 2^32 points.
+    std::uint32_t sample (std::uint64_t index, int d) const {
+      const std::uint32_t i = std::uint32_t(index);
+      const std::uint32_t (&table)[sobol_bits / 4][16] = table_[d];
+      std::uint32_t x = table[0][i & 15u] ^ table[1][(i >> 4) & 15u]
+                      ^ table[2][(i >> 8) & 15u] ^ table[3][(i >> 12) & 15u]
+                      ^ table[4][(i >> 16) & 15u] ^ table[5][(i >> 20) & 15u]
+                      ^ table[6][(i >> 24) & 15u] ^ table[7][i >> 28];
+      x = detail::sobol_reverse_bits(x);
+      x = detail::sobol_laine_karras(x, seed_[d]);
+      return detail::sobol_reverse_bits(x);
+    }
+
+    // The same point in [0, 1); the value is rounded down so that it is
+    // always below 1 in the precision T
+    template <typename T>
+    T uniform (std::uint64_t index, int d) const {
+      const T u = T(double(sample(index, d)) * (1.0 / 4294967296.0));
+      return (u < T(1.0)) ? u : std::nextafter(T(1.0), T(0.0));
+    }
+
+   private:
+    int dims_;
+    std::uint32_t table_[sobol_max_dims][sobol_bits / 4][16];
+    std::uint32_t seed_[sobol_max_dims];
+  };
+
+}
+
+#endif
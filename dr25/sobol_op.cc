@@ -0,0 +1,76 @@
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+#include "sobol.h"
+
+using namespace tensorflow;
+
+// Rough cost (in cycles) of one coordinate: up to 32 XORs of direction
+// numbers and the scramble
+static const int64 kSobolCostPerElement = 60;
+
+REGISTER_OP("SobolSample")
+  .Attr("T: {float, double}")
+  .Attr("num_samples: int")
+  .Attr("dims: int")
+  .Attr("offset: int = 0")
+  .Attr("seed: int = 42")
+  .Output("samples: T")
+  .SetShapeFn([](shape_inference::InferenceContext* c) {
+    int64 num_samples, dims;
+    TF_RETURN_IF_ERROR(c->GetAttr("num_samples", &num_samples));
+    TF_RETURN_IF_ERROR(c->GetAttr("dims", &dims));
+    c->set_output(0, c->Matrix(num_samples, dims));
+    return Status::OK();
+  });
+
+template <typename T>
+class SobolSampleOp : public OpKernel {
+ public:
+  explicit SobolSampleOp(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("num_samples", &num_samples_));
+    OP_REQUIRES_OK(context, context->GetAttr("dims", &dims_));
+    OP_REQUIRES_OK(context, context->GetAttr("offset", &offset_));
+    OP_REQUIRES_OK(context, context->GetAttr("seed", &seed_));
+    OP_REQUIRES(context, num_samples_ >= 0, errors::InvalidArgument("'num_samples' must be non-negative"));
+    OP_REQUIRES(context, (dims_ >= 1 && dims_ <= batman::sobol_max_dims),
+                errors::InvalidArgument("'dims' must be between 1 and ", batman::sobol_max_dims));
+    OP_REQUIRES(context, offset_ >= 0, errors::InvalidArgument("'offset' must be non-negative"));
+    OP_REQUIRES(context, (offset_ + num_samples_ <= (int64(1) << batman::sobol_bits)),
+                errors::InvalidArgument("the sequence only has 2^32 points"));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    // Output
+    Tensor* samples_tensor = NULL;
+    OP_REQUIRES_OK(context, context->allocate_output(0, TensorShape({num_samples_, dims_}), &samples_tensor));
+    auto samples = samples_tensor->template matrix<T>();
+
+    // Every point is computed from its index so the shards are independent
+    const batman::SobolSequence sequence(static_cast<int>(dims_), static_cast<std::uint64_t>(seed_));
+    auto work = [&](int64 begin, int64 end) {
+      for (int64 n = begin; n < end; ++n)
+        for (int64 d = 0; d < dims_; ++d)
+          samples(n, d) = sequence.template uniform<T>(std::uint64_t(offset_ + n), int(d));
+    };
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+    Shard(worker_threads.num_threads, worker_threads.workers, num_samples_,
+          dims_ * kSobolCostPerElement, work);
+  }
+
+ private:
+  int64 num_samples_, dims_, offset_, seed_;
+};
+
+
+#define REGISTER_KERNEL(type)                                                 \
+  REGISTER_KERNEL_BUILDER(                                                    \
+      Name("SobolSample").Device(DEVICE_CPU).TypeConstraint<type>("T"),        \
+      SobolSampleOp<type>)
+
+REGISTER_KERNEL(float);
+REGISTER_KERNEL(double);
+
+#undef REGISTER_KERNEL
@@ -0,0 +1,124 @@
+#ifndef _DR25_TRANSIT_H_
+#define _DR25_TRANSIT_H_
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "quad.h"
+#include "quad_grad.h"
+
+namespace batman {
+
+  using std::abs;
+  using std::sin;
+  using std::cos;
+  using std::asin;
+  using std::floor;
+
+  // Light curves of a planet on a circular orbit. The orbit is parameterized
+  // by the time of a mid-transit t0, the period, the semi-major axis a and
+  // the impact parameter b (both in units of the stellar radius). With the
+  // orbital phase phi = 2 pi (t - t0) / period the sky position of the
+  // planet is
+  //
+  //   x = a sin(phi),  y = b cos(phi)
+  //
+  // and it is in front of the star when cos(phi) > 0. Each cadence is
+  // integrated over an exposure time texp using K points at the midpoints
+  // of K equal sub-exposures; the sub-exposures are never stored.
+
+  // Half of the width (in time) of the window around each mid-transit
+  // outside of which every point of an exposure is out of transit, so that
+  // the flux is exactly 1 and all of the derivatives are 0
+  template <typename T>
+  inline T transit_half_window (const T& p, const T& period, const T& a, const T& texp) {
+    T arg = (T(1.0) + p) / a;
+    if (!(arg < T(1.0))) return std::numeric_limits<T>::infinity();
+    return T(0.5) * (period * asin(arg) / T(M_PI) + texp);
+  }
+
+  // The time since the nearest mid-transit, in [-period/2, period/2]
+  template <typename T>
+  inline T transit_offset (const T& t, const T& t0, const T& period) {
+    T dt = t - t0;
+    return dt - period * floor(dt / period + T(0.5));
+  }
+
+  // The separation at the offset dt from mid-transit; +inf when the planet
+  // is behind the star
+  template <typename T>
+  inline T transit_separation (const T& dt, const T& period, const T& a, const T& b) {
+    T phi = T(2.0 * M_PI) * dt / period;
+    T c = cos(phi);
+    if (!(c > T(0.0))) return std::numeric_limits<T>::infinity();
+    T x = a * sin(phi), y = b * c;
+    return sqrt(x * x + y * y);
+  }
+
+  // The exposure integrated flux at the time t
+  template <typename T>
+  inline T transit_flux (const T& g1, const T& g2, const T& p, const T& t0,
+                         const T& period, const T& a, const T& b, const T& t,
+                         const T& texp, int K, const T& half_window) {
+    T dt = transit_offset<T>(t, t0, period);
+    if (abs(dt) > half_window) return T(1.0);
+    T flux = T(0.0);
+    for (int k = 0; k < K; ++k) {
+      T dtk = dt + texp * (T(k + 0.5) / T(K) - T(0.5));
+      flux += quad<T>(g1, g2, p, transit_separation<T>(dtk, period, a, b));
+    }
+    return flux / T(K);
+  }
+
+  // transit_flux and its partial derivatives with respect to the limb
+  // darkening, p, the orbit and t. The derivative with respect to the
+  // period includes the number of orbits since t0.
+  template <typename T>
+  inline T transit_flux_grad (const T& g1, const T& g2, const T& p, const T& t0,
+                              const T& period, const T& a, const T& b, const T& t,
+                              const T& texp, int K, const T& half_window,
+                              T& dg1, T& dg2, T& dp, T& dt0, T& dperiod,
+                              T& da, T& db, T& dt) {
+    dg1 = dg2 = dp = dt0 = dperiod = da = db = dt = T(0.0);
+    T offset = transit_offset<T>(t, t0, period);
+    if (abs(offset) > half_window) return T(1.0);
+
+    const T norm = T(1.0) / T(K), dphi_dt = T(2.0 * M_PI) / period;
+    T flux = T(0.0), dphi = T(0.0);
+    for (int k = 0; k < K; ++k) {
+      T shift = texp * (T(k + 0.5) / T(K) - T(0.5));
+      T phi = dphi_dt * (offset + shift);
+      T s = sin(phi), c = cos(phi);
+      if (!(c > T(0.0))) {
+        flux += T(1.0);
+        continue;
+      }
+      T x = a * s, y = b * c, z = sqrt(x * x + y * y);
+      T fg1, fg2, fp, fz;
+      flux += quad_grad<T>(g1, g2, p, z, fg1, fg2, fp, fz);
+      dg1 += fg1;
+      dg2 += fg2;
+      dp += fp;
+      if (z > T(0.0)) {
+        T fz_z = fz / z;
+        da += fz_z * a * s * s;
+        db += fz_z * b * c * c;
+        dphi += fz_z * (a * a - b * b) * s * c;
+        // d(phi)/d(period) = -phi / period with the unwrapped phase
+        dperiod -= fz_z * (a * a - b * b) * s * c * (t - t0 + shift) / period;
+      }
+    }
+    dg1 *= norm;
+    dg2 *= norm;
+    dp *= norm;
+    da *= norm;
+    db *= norm;
+    dt = dphi * dphi_dt * norm;
+    dt0 = -dt;
+    dperiod *= dphi_dt * norm;
+    return flux * norm;
+  }
+
+}
+
+#endif
@@ -0,0 +1,111 @@
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+#include "kernels.h"
+
+using namespace tensorflow;
+
+// Rough cost (in cycles) of one exposure point that is in transit: a call to
+// batman::quad plus the sin and cos of the phase. Cadences outside of the
+// transit window cost next to nothing but, like Quad, we quote the
+// in-transit cost to keep the shards balanced.
+static const int64 kTransitCostPerPoint = 1200;
+
+REGISTER_OP("TransitLightCurve")
+  .Attr("T: {float, double}")
+  .Attr("texp: float = 0.0")
+  .Attr("oversample: int = 1")
+  .Input("g1: T")
+  .Input("g2: T")
+  .Input("p: T")
+  .Input("t0: T")
+  .Input("period: T")
+  .Input("a: T")
+  .Input("b: T")
+  .Input("t: T")
+  .Output("flux: T")
+  .SetShapeFn([](shape_inference::InferenceContext* c) {
+    shape_inference::ShapeHandle s;
+    shape_inference::DimensionHandle d;
+    TF_RETURN_IF_ERROR(c->Merge(c->input(0), c->input(1), &s));
+    for (int k = 2; k < 7; ++k) TF_RETURN_IF_ERROR(c->Merge(s, c->input(k), &s));
+    TF_RETURN_IF_ERROR(c->Merge(c->Dim(s, 0), c->Dim(c->input(7), 0), &d));
+    c->set_output(0, c->input(7));
+    return Status::OK();
+  });
+
+template <typename T>
+class TransitLightCurveOp : public OpKernel {
+ public:
+  explicit TransitLightCurveOp(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("texp", &texp_));
+    OP_REQUIRES_OK(context, context->GetAttr("oversample", &oversample_));
+    OP_REQUIRES(context, texp_ >= 0.0, errors::InvalidArgument("'texp' must be non-negative"));
+    OP_REQUIRES(context, oversample_ >= 1, errors::InvalidArgument("'oversample' must be at least 1"));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    // Inputs
+    const Tensor& g1_tensor = context->input(0);
+    const Tensor& g2_tensor = context->input(1);
+    const Tensor& p_tensor = context->input(2);
+    const Tensor& t0_tensor = context->input(3);
+    const Tensor& period_tensor = context->input(4);
+    const Tensor& a_tensor = context->input(5);
+    const Tensor& b_tensor = context->input(6);
+    const Tensor& t_tensor = context->input(7);
+
+    // Dimensions
+    int64 N = g1_tensor.NumElements();
+    int64 M = 1;
+    if (t_tensor.dims() > g1_tensor.dims()) {
+      OP_REQUIRES(context, (t_tensor.dims() == g1_tensor.dims() + 1), errors::InvalidArgument("invalid dimensions"));
+      M = t_tensor.dim_size(t_tensor.dims() - 1);
+    }
+    for (int k = 1; k < 7; ++k)
+      OP_REQUIRES(context, (context->input(k).NumElements() == N), errors::InvalidArgument("all inputs must have matching shapes"));
+    OP_REQUIRES(context, (t_tensor.NumElements() == N * M), errors::InvalidArgument("all inputs must have matching shapes"));
+
+    // Output
+    Tensor* flux_tensor = NULL;
+    OP_REQUIRES_OK(context, context->allocate_output(0, t_tensor.shape(), &flux_tensor));
+
+    // Access the data
+    const auto g1 = g1_tensor.template flat<T>();
+    const auto g2 = g2_tensor.template flat<T>();
+    const auto p = p_tensor.template flat<T>();
+    const auto t0 = t0_tensor.template flat<T>();
+    const auto period = period_tensor.template flat<T>();
+    const auto a = a_tensor.template flat<T>();
+    const auto b = b_tensor.template flat<T>();
+    const auto t = t_tensor.template flat<T>();
+    auto flux = flux_tensor->template flat<T>();
+
+    const batman::kernel_table<T>& kernels = batman::kernels<T>();
+    const T texp = T(texp_);
+    const int K = oversample_;
+    auto work = [&](int64 begin, int64 end) {
+      kernels.transit(begin, end, M, g1.data(), g2.data(), p.data(), t0.data(), period.data(),
+                      a.data(), b.data(), t.data(), texp, K, flux.data());
+    };
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+    Shard(worker_threads.num_threads, worker_threads.workers, N * M,
+          K * kTransitCostPerPoint, work);
+  }
+ private:
+  float texp_;
+  int oversample_;
+};
+
+
+#define REGISTER_KERNEL(type)                                                 \
+  REGISTER_KERNEL_BUILDER(                                                    \
+      Name("TransitLightCurve").Device(DEVICE_CPU).TypeConstraint<type>("T"), \
+      TransitLightCurveOp<type>)
+
+REGISTER_KERNEL(float);
+REGISTER_KERNEL(double);
+
+#undef REGISTER_KERNEL
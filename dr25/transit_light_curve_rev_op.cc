@@ -0,0 +1,147 @@
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "transit.h"
+#include "reduce.h"
+
+using namespace tensorflow;
+
+// Rough cost (in cycles) of one exposure point that is in transit: a call to
+// batman::quad_grad plus the chain rule through the orbit
+static const int64 kTransitRevCostPerPoint = 1700;
+
+// The block size for the per-star reductions; see batman::blocked_sum
+static const int64 kTransitRevBlockSize = 256;
+
+// The number of per-star parameters: g1, g2, p, t0, period, a and b
+static const int kTransitNumParams = 7;
+
+REGISTER_OP("TransitLightCurveRev")
+  .Attr("T: {float, double}")
+  .Attr("texp: float = 0.0")
+  .Attr("oversample: int = 1")
+  .Input("g1: T")
+  .Input("g2: T")
+  .Input("p: T")
+  .Input("t0: T")
+  .Input("period: T")
+  .Input("a: T")
+  .Input("b: T")
+  .Input("t: T")
+  .Input("bflux: T")
+  .Output("bg1: T")
+  .Output("bg2: T")
+  .Output("bp: T")
+  .Output("bt0: T")
+  .Output("bperiod: T")
+  .Output("ba: T")
+  .Output("bb: T")
+  .Output("bt: T")
+  .SetShapeFn([](shape_inference::InferenceContext* c) {
+    shape_inference::ShapeHandle s, t;
+    shape_inference::DimensionHandle d;
+    TF_RETURN_IF_ERROR(c->Merge(c->input(0), c->input(1), &s));
+    for (int k = 2; k < 7; ++k) TF_RETURN_IF_ERROR(c->Merge(s, c->input(k), &s));
+    TF_RETURN_IF_ERROR(c->Merge(c->Dim(s, 0), c->Dim(c->input(7), 0), &d));
+    TF_RETURN_IF_ERROR(c->Merge(c->input(7), c->input(8), &t));
+    for (int k = 0; k < 7; ++k) c->set_output(k, s);
+    c->set_output(7, t);
+    return Status::OK();
+  });
+
+template <typename T>
+class TransitLightCurveRevOp : public OpKernel {
+ public:
+  explicit TransitLightCurveRevOp(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("texp", &texp_));
+    OP_REQUIRES_OK(context, context->GetAttr("oversample", &oversample_));
+    OP_REQUIRES(context, texp_ >= 0.0, errors::InvalidArgument("'texp' must be non-negative"));
+    OP_REQUIRES(context, oversample_ >= 1, errors::InvalidArgument("'oversample' must be at least 1"));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    // Inputs
+    const Tensor& g1_tensor = context->input(0);
+    const Tensor& t_tensor = context->input(7);
+    const Tensor& bflux_tensor = context->input(8);
+
+    // Dimensions
+    const int64 N = g1_tensor.NumElements();
+    int64 M = 1;
+    if (t_tensor.dims() > g1_tensor.dims()) {
+      OP_REQUIRES(context, (t_tensor.dims() == g1_tensor.dims() + 1), errors::InvalidArgument("invalid dimensions"));
+      M = t_tensor.dim_size(t_tensor.dims() - 1);
+    }
+    for (int k = 1; k < kTransitNumParams; ++k)
+      OP_REQUIRES(context, (context->input(k).NumElements() == N), errors::InvalidArgument("all inputs must have matching shapes"));
+    OP_REQUIRES(context, (t_tensor.NumElements() == N * M), errors::InvalidArgument("all inputs must have matching shapes"));
+    OP_REQUIRES(context, (bflux_tensor.NumElements() == N * M), errors::InvalidArgument("all inputs must have matching shapes"));
+
+    // Outputs; the gradients for the per-star parameters are indexed
+    // [k][n] in the order of the inputs
+    const T* params[kTransitNumParams];
+    T* bparams[kTransitNumParams];
+    for (int k = 0; k < kTransitNumParams; ++k) {
+      Tensor* out_tensor = NULL;
+      OP_REQUIRES_OK(context, context->allocate_output(k, g1_tensor.shape(), &out_tensor));
+      params[k] = context->input(k).template flat<T>().data();
+      bparams[k] = out_tensor->template flat<T>().data();
+    }
+    Tensor* bt_tensor = NULL;
+    OP_REQUIRES_OK(context, context->allocate_output(7, t_tensor.shape(), &bt_tensor));
+
+    // Access the data
+    const auto t = t_tensor.template flat<T>();
+    const auto bflux = bflux_tensor.template flat<T>();
+    auto bt = bt_tensor->template flat<T>();
+
+    // The per-star sums of the parameter gradients
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+    auto shard = [&](int64 units, int64 cost, const std::function<void(int64, int64)>& work) {
+      Shard(worker_threads.num_threads, worker_threads.workers, units, cost, work);
+    };
+    Tensor partial_tensor;
+    OP_REQUIRES_OK(context, context->allocate_temp(DataTypeToEnum<T>::value,
+                                                   TensorShape({kTransitNumParams, N, batman::blocked_sum_blocks(M, kTransitRevBlockSize)}),
+                                                   &partial_tensor));
+    const T texp = T(texp_);
+    const int oversample = oversample_;
+    auto block = [&](int64 n, int64 begin, int64 end, T* sum) {
+      const T g1 = params[0][n], g2 = params[1][n], p = params[2][n], t0 = params[3][n],
+              period = params[4][n], a = params[5][n], b = params[6][n];
+      const T half_window = batman::transit_half_window<T>(p, period, a, texp);
+      T grad[kTransitNumParams], dt;
+      for (int64 m = begin; m < end; ++m) {
+        int64 i = n * M + m;
+        batman::transit_flux_grad<T>(g1, g2, p, t0, period, a, b, t(i), texp, oversample,
+                                     half_window, grad[0], grad[1], grad[2], grad[3],
+                                     grad[4], grad[5], grad[6], dt);
+        for (int q = 0; q < kTransitNumParams; ++q) sum[q] += bflux(i) * grad[q];
+        bt(i) = bflux(i) * dt;
+      }
+    };
+    batman::blocked_sum<kTransitNumParams>(N, M, kTransitRevBlockSize, partial_tensor.template flat<T>().data(),
+                                           shard, oversample * kTransitRevCostPerPoint, block,
+                                           [&](int q, int64 n, T value) { bparams[q][n] = value; });
+  }
+ private:
+  float texp_;
+  int oversample_;
+};
+
+
+#define REGISTER_KERNEL(type)                                                 \
+  REGISTER_KERNEL_BUILDER(                                                    \
+      Name("TransitLightCurveRev").Device(DEVICE_CPU).TypeConstraint<type>("T"), \
+      TransitLightCurveRevOp<type>)
+
+REGISTER_KERNEL(float);
+REGISTER_KERNEL(double);
+
+#undef REGISTER_KERNEL
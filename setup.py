@@ -2,18 +2,33 @@
 # -*- coding: utf-8 -*-
 
 import os
+import sys
 from setuptools import setup, Extension
 
 import numpy
 import pybind11
 import tensorflow as tf
 
-link_args = ["-march=native", "-mmacosx-version-min=10.9"]
-args = ["-O2", "-std=c++14", "-stdlib=libc++"] + link_args
+# The hot kernels are compiled for each instruction set level and chosen at
+# load time (see dr25/kernels.h) so the default build runs on any x86-64 CPU.
+# Set DR25_NATIVE=1 to build everything for the host CPU instead.
+link_args = []
+args = ["-O3", "-std=c++14"]
+if sys.platform == "darwin":
+    link_args += ["-stdlib=libc++", "-mmacosx-version-min=10.9"]
+else:
+    link_args += ["-pthread"]
+if os.environ.get("DR25_NATIVE", "0") not in ("", "0"):
+    args += ["-march=native"]
+args += link_args
+
+kernel_sources = [os.path.join("dr25", name) for name in [
+    "kernels.cc", "kernels_generic.cc", "kernels_avx2.cc", "kernels_avx512.cc"]]
+
 ext_modules = [
     Extension(
         "dr25.quad",
-        [os.path.join("dr25", "quad.cc")],
+        [os.path.join("dr25", "quad.cc")] + kernel_sources,
         include_dirs=[
             pybind11.get_include(False),
             pybind11.get_include(True),
@@ -25,11 +40,44 @@ ext_modules = [
         extra_compile_args=args,
         extra_link_args=link_args,
     ),
+    Extension(
+        "dr25.ipac",
+        [os.path.join("dr25", "ipac.cc")],
+        include_dirs=[
+            pybind11.get_include(False),
+            pybind11.get_include(True),
+            numpy.get_include(),
+            "dr25",
+        ],
+        language="c++",
+        extra_compile_args=args,
+        extra_link_args=link_args,
+    ),
     Extension(
         "dr25.ops",
         [os.path.join("dr25", "quad_op.cc"),
          os.path.join("dr25", "quad_rev_op.cc"),
-         os.path.join("dr25", "interp_op.cc")],
+         os.path.join("dr25", "quad_with_grad_op.cc"),
+         os.path.join("dr25", "quad_table_op.cc"),
+         os.path.join("dr25", "quad_basis_op.cc"),
+         os.path.join("dr25", "quad_basis_rev_op.cc"),
+         os.path.join("dr25", "quad_combine_op.cc"),
+         os.path.join("dr25", "quad_combine_rev_op.cc"),
+         os.path.join("dr25", "interp_op.cc"),
+         os.path.join("dr25", "interp_grad_y_op.cc"),
+         os.path.join("dr25", "interp_gather_op.cc"),
+         os.path.join("dr25", "interp_gather_rev_op.cc"),
+         os.path.join("dr25", "interp_index_op.cc"),
+         os.path.join("dr25", "interp_apply_op.cc"),
+         os.path.join("dr25", "interp_apply_rev_op.cc"),
+         os.path.join("dr25", "interp_apply_grad_y_op.cc"),
+         os.path.join("dr25", "transit_light_curve_op.cc"),
+         os.path.join("dr25", "transit_light_curve_rev_op.cc"),
+         os.path.join("dr25", "kepler_op.cc"),
+         os.path.join("dr25", "detection_probability_op.cc"),
+         os.path.join("dr25", "detection_probability_rev_op.cc"),
+         os.path.join("dr25", "expected_detections_op.cc"),
+         os.path.join("dr25", "sobol_op.cc")] + kernel_sources,
         include_dirs=["dr25", ],
         language="c++",
         extra_compile_args=args+tf.sysconfig.get_compile_flags(),